@@ -37,6 +37,9 @@ int main()
     Settings.IsSet.IdleTimeoutMs = TRUE;
     Settings.PeerUnidiStreamCount = (std::numeric_limits<std::uint16_t>::max());
     Settings.IsSet.PeerUnidiStreamCount = TRUE;
+    // subscriptions may ask for objects in datagrams
+    Settings.IsSet.DatagramReceiveEnabled = TRUE;
+    Settings.DatagramReceiveEnabled = TRUE;
     moqtClient->set_Settings(&Settings, sizeof(Settings));
 
     moqtClient->set_CredConfig(get_cred_config());
@@ -63,6 +63,31 @@ static constexpr auto server_connection_callback =
             // moqtServer->cleanup_connection(connection);
             break;
         }
+        case QUIC_CONNECTION_EVENT_STREAMS_AVAILABLE:
+        {
+            // indicated once the peer's limits are known and whenever it
+            // raises them
+            moqtServer->set_available_streams(connection,
+                                              event->STREAMS_AVAILABLE.UnidirectionalCount);
+            break;
+        }
+        case QUIC_CONNECTION_EVENT_DATAGRAM_STATE_CHANGED:
+        {
+            // datagrams can be sent once the peer enabled receiving them,
+            // the path MTU bounds their length
+            moqtServer->set_datagram_state(connection, event->DATAGRAM_STATE_CHANGED.SendEnabled,
+                                           event->DATAGRAM_STATE_CHANGED.MaxSendLength);
+            break;
+        }
+        case QUIC_CONNECTION_EVENT_DATAGRAM_SEND_STATE_CHANGED:
+        {
+            // acknowledged, lost or canceled, releases the reference on the
+            // object payload
+            if (QUIC_DATAGRAM_SEND_STATE_IS_FINAL(event->DATAGRAM_SEND_STATE_CHANGED.State))
+                delete static_cast<DatagramSendContext*>(
+                event->DATAGRAM_SEND_STATE_CHANGED.ClientContext);
+            break;
+        }
         case QUIC_CONNECTION_EVENT_PEER_STREAM_STARTED:
         {
             // remotely opened streams call this callback => they must
@@ -169,9 +194,37 @@ static constexpr auto server_data_stream_callback =
         }
         case QUIC_STREAM_EVENT_SHUTDOWN_COMPLETE:
         {
+            // finished at the end of its group or aborted, the state of the
+            // stream is freed so that it does not pile up over the session.
+            // Streams of a connection which shuts down are freed with the
+            // ConnectionState, which may be going away right now
+            if (!event->SHUTDOWN_COMPLETE.ConnectionShutdown &&
+                !event->SHUTDOWN_COMPLETE.AppCloseInProgress)
+            {
+                streamContext->connectionState_.delete_data_stream(dataStream);
+                streamContext->moqtObject_.get_tbl()->StreamClose(dataStream);
+            }
             delete streamContext;
             break;
         }
+        case QUIC_STREAM_EVENT_SEND_COMPLETE:
+        {
+            // also indicated for sends canceled by an abort, releases the
+            // reference on the object payload
+            StreamSendContext* streamSendContext =
+            static_cast<StreamSendContext*>(event->SEND_COMPLETE.ClientContext);
+
+            delete streamSendContext;
+            break;
+        }
+        case QUIC_STREAM_EVENT_IDEAL_SEND_BUFFER_SIZE:
+        {
+            // derived from the congestion window of the connection, the same
+            // for every stream of it
+            streamContext->connectionState_.set_ideal_send_buffer_size(
+            event->IDEAL_SEND_BUFFER_SIZE.ByteCount);
+            break;
+        }
         case QUIC_STREAM_EVENT_COPIED_TO_FRAME:
         {
             StreamSendContext& streamSendContext =
@@ -191,8 +244,9 @@ static constexpr auto server_data_stream_callback =
             }
 
             std::uint64_t totalLength = 0;
-            for (std::uint32_t i = 0; i < streamSendContext.bufferCount; i++)
-                totalLength += streamSendContext.buffer[i].Length;
+            auto [buffers, bufferCount] = streamSendContext.get_buffers();
+            for (std::uint32_t i = 0; i < bufferCount; i++)
+                totalLength += buffers[i].Length;
 
             totalLength += networkStats.BytesInFlight;
 
@@ -207,20 +261,18 @@ static constexpr auto server_data_stream_callback =
                 std::chrono::duration_cast<std::chrono::milliseconds>(timeLeftToSend)
                 .count())
             {
-                streamContext->connectionState_.dataStreams.write(
+                ConnectionState& connectionState = streamContext->connectionState_;
+                // aborted once the lock is released
+                rvn::unique_stream stream = connectionState.dataStreams.write(
                 [&, dataStream, event](auto& dataStreams)
                 {
-                    auto iter = std::find_if(dataStreams.begin(), dataStreams.end(),
-                                             [&](DataStreamState& streamState)
-                                             {
-                                                 return streamState.stream.get() == dataStream;
-                                             });
-                    if (iter != dataStreams.end())
+                    if (auto iter = connectionState.find_data_stream(dataStream))
                     {
                         *event->COPIED_TO_FRAME.BytesCopiedBeforeNextEvent =
                         (uint64_t)-2;
-                        dataStreams.erase(iter);
+                        return connectionState.erase_data_stream(dataStreams, *iter);
                     }
+                    return rvn::unique_stream();
                 });
             }
 
@@ -389,6 +441,12 @@ static constexpr auto client_connection_callback =
 
             break;
         }
+        case QUIC_CONNECTION_EVENT_DATAGRAM_RECEIVED:
+        {
+            // objects of subscriptions delivered in datagrams
+            moqtClient->connectionState->receive_datagram(*event->DATAGRAM_RECEIVED.Buffer);
+            break;
+        }
         default: break;
     }
     return QUIC_STATUS_SUCCESS;
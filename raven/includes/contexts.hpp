@@ -1,12 +1,22 @@
 #pragma once
 //////////////////////////////
 #include <data_manager.hpp>
+#include <send_scheduler.hpp>
 #include <serialization/messages.hpp>
+#include <shared_quic_buffer.hpp>
 #include <strong_types.hpp>
 //////////////////////////////
+#include <array>
+#include <atomic>
+#include <boost/container/small_vector.hpp>
+#include <boost/functional/hash.hpp>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <object_pool.hpp>
 #include <optional>
+#include <span>
+#include <unordered_map>
 //////////////////////////////
 #include <definitions.hpp>
 #include <deserializer.hpp>
@@ -30,6 +40,8 @@ enum class StreamType
 struct StreamContext
 {
     std::atomic_bool streamHasBeenConstructed{};
+    // StreamSends on the stream which have not completed yet
+    std::atomic<std::uint64_t> numPendingSends_{};
     class MOQT& moqtObject_;
     /*  We can not have reference to StreamState
         StreamState constructor takes rvn::unique_stream which requires
@@ -50,47 +62,119 @@ struct StreamContext
     {
     }
 
+    // one per data stream, deleted on SHUTDOWN_COMPLETE on a msquic worker
+    static void* operator new(std::size_t)
+    {
+        return ObjectPool<StreamContext>::allocate();
+    }
+    static void operator delete(void* ptr) noexcept
+    {
+        ObjectPool<StreamContext>::deallocate(ptr);
+    }
+
     // deserializer can not be constructed in the constructor and has to be
     // done seperately
     void construct_deserializer(StreamState& streamState, bool isControlStream);
 };
 
+/*
+    Context of one StreamSend, which may gather several buffers (a subgroup
+    header and the objects following it) so that consecutive objects of a
+    stream cost one call, one context and one completion
+*/
 class StreamSendContext
 {
 public:
-    // owns the QUIC_BUFFERS
-    QUIC_BUFFER* buffer;
-    std::uint32_t bufferCount;
+    // objects gathered by one send
+    static constexpr std::size_t maxObjectsPerSend = 16;
+    // a full send with its subgroup header does not spill to the heap
+    static constexpr std::size_t inlineBuffers = maxObjectsPerSend + 1;
+    using Buffers = boost::container::small_vector<SharedQuicBuffer, inlineBuffers>;
+
+    // holds a reference on the buffers until SEND_COMPLETE, object payloads
+    // are shared between every subscriber and the track store
+    Buffers buffers_;
+    // passed to StreamSend, msquic reads it until SEND_COMPLETE
+    boost::container::small_vector<QUIC_BUFFER, inlineBuffers> quicBuffers_;
 
-    // non owning reference
-    const StreamContext* streamContext;
+    // non owning reference, outlives the send (deleted on SHUTDOWN_COMPLETE)
+    StreamContext* streamContext;
 
     std::optional<TimePoint> timeout_;
 
-    StreamSendContext(QUIC_BUFFER* buffer_,
-                      const std::uint32_t bufferCount_,
-                      const StreamContext* streamContext_,
-                      std::optional<TimePoint> timeout)
-    : buffer(buffer_), bufferCount(bufferCount_), streamContext(streamContext_),
-      timeout_(timeout)
+    // summed length of the buffers, kept as destroy_buffers drops them early
+    std::uint64_t numBytes_ = 0;
+
+    // the buffers are accounted as in flight on the connection until the
+    // context is deleted
+    StreamSendContext(Buffers buffers, StreamContext* streamContext_, std::optional<TimePoint> timeout);
+    StreamSendContext(SharedQuicBuffer buffer, StreamContext* streamContext_, std::optional<TimePoint> timeout)
+    : StreamSendContext(Buffers{ std::move(buffer) }, streamContext_, timeout)
     {
-        utils::ASSERT_LOG_THROW(bufferCount == 1, "bufferCount should be 1", bufferCount);
     }
+    ~StreamSendContext();
 
-    ~StreamSendContext()
+    // one per StreamSend, deleted on SEND_COMPLETE on a msquic worker
+    static void* operator new(std::size_t)
     {
-        destroy_buffers();
+        return ObjectPool<StreamSendContext>::allocate();
+    }
+    static void operator delete(void* ptr) noexcept
+    {
+        ObjectPool<StreamSendContext>::deallocate(ptr);
     }
 
     std::tuple<QUIC_BUFFER*, std::uint32_t> get_buffers()
     {
-        return { buffer, bufferCount };
+        return { quicBuffers_.data(), static_cast<std::uint32_t>(quicBuffers_.size()) };
     }
+    // drops the references, buffers are freed if they were the last ones
     void destroy_buffers()
     {
-        // We do nothing in destroy buffers as some part of the codebase uses 0
-        // copy send
-        // TODO: fix this
+        quicBuffers_.clear();
+        buffers_.clear();
+    }
+};
+
+/*
+    Context of one DatagramSend, an object in an OBJECT_DATAGRAM. The header
+    is serialized into the context, the payload length and payload are sent
+    from the stored object (Object::payload_length_offset) without copying
+*/
+class DatagramSendContext
+{
+public:
+    using HeaderBytes = std::array<std::uint8_t, ObjectDatagramHeader::maxSerializedLength>;
+
+    HeaderBytes header_;
+    // holds a reference on the object until its final send state
+    SharedQuicBuffer object_;
+    // passed to DatagramSend, the first one points into header_ and the
+    // second one into object_
+    std::array<QUIC_BUFFER, 2> quicBuffers_;
+
+    struct ConnectionState& connectionState_;
+
+    std::uint64_t numBytes_;
+
+    // the first headerLength bytes of header are sent, then object from
+    // objectOffset
+    DatagramSendContext(const HeaderBytes& header,
+                        std::uint32_t headerLength,
+                        SharedQuicBuffer object,
+                        std::uint32_t objectOffset,
+                        struct ConnectionState& connectionState);
+    ~DatagramSendContext();
+
+    // one per DatagramSend, deleted on its final DATAGRAM_SEND_STATE_CHANGED
+    // on a msquic worker
+    static void* operator new(std::size_t)
+    {
+        return ObjectPool<DatagramSendContext>::allocate();
+    }
+    static void operator delete(void* ptr) noexcept
+    {
+        ObjectPool<DatagramSendContext>::deallocate(ptr);
     }
 };
 
@@ -113,6 +197,27 @@ struct StreamState
     }
 };
 
+// subgroup sent on an outgoing data stream
+struct DataStreamKey
+{
+    std::uint64_t trackId_;
+    std::uint64_t groupId_;
+    std::uint64_t subgroupId_;
+
+    bool operator==(const DataStreamKey&) const = default;
+};
+
+struct DataStreamKeyHash
+{
+    std::size_t operator()(const DataStreamKey& key) const noexcept
+    {
+        std::size_t seed = std::hash<std::uint64_t>{}(key.trackId_);
+        boost::hash_combine(seed, key.groupId_);
+        boost::hash_combine(seed, key.subgroupId_);
+        return seed;
+    }
+};
+
 class DataStreamState : public StreamState
 {
     // return weak_ptr to this for 3rd party to observe lifetime of the
@@ -123,9 +228,10 @@ public:
     // To be used by subscriber to receive objects on this stream
     std::shared_ptr<MPMCQueue<StreamHeaderSubgroupObject>> objectQueue_;
     std::shared_ptr<StreamHeaderSubgroupMessage> streamHeaderSubgroupMessage_;
+    // set on the streams we send on, indexed in ConnectionState::sendStreams_
+    std::optional<DataStreamKey> sendKey_;
 
     DataStreamState(rvn::unique_stream&& stream, struct ConnectionState& connectionState);
-    bool can_send_object(const ObjectIdentifier& objectIdentifier) const noexcept;
     void set_header(StreamHeaderSubgroupMessage streamHeaderSubgroupMessage);
     std::weak_ptr<void> get_life_time_flag() const noexcept;
 };
@@ -138,32 +244,168 @@ struct ConnectionState : std::enable_shared_from_this<ConnectionState>
     // StreamManager
     // //////////////////////////////////////////////////////////////
     std::shared_mutex trackAliasMtx_;
-    std::unordered_map<TrackIdentifier, TrackAlias, TrackIdentifier::Hash, TrackIdentifier::Equal> trackAliasMap_;
-    std::unordered_map<std::uint64_t, TrackIdentifier> trackAliasRevMap_;
+    // alias of each subscribed track (chosen by the subscriber), keyed on TrackId
+    std::unordered_map<TrackId, TrackAlias, StrongTypeHash> trackAliasMap_;
+    // track of each alias, keyed on the alias from the wire
+    std::unordered_map<TrackAlias, TrackIdentifier, StrongTypeHash> trackAliasRevMap_;
 
     void add_track_alias(TrackIdentifier trackIdentifier, TrackAlias trackAlias);
 
     // wtf is currGroup?
     std::shared_mutex currGroupMtx_;
-    std::unordered_map<TrackIdentifier, GroupId, TrackIdentifier::Hash, TrackIdentifier::Equal> currGroupMap_;
+    // keyed on TrackId
+    std::unordered_map<std::uint64_t, GroupId> currGroupMap_;
     std::optional<GroupId> get_current_group(const TrackIdentifier& trackIdentifier);
     std::optional<GroupId> get_current_group(TrackAlias trackAlias);
 
     std::optional<TrackIdentifier> alias_to_identifier(TrackAlias trackAlias);
     std::optional<TrackAlias> identifier_to_alias(const TrackIdentifier& trackIdentifier);
 
-    RWProtected<StableContainer<DataStreamState>> dataStreams;
+    // Send budget
+    // //////////////////////////////////////////////////////////////
+    // objects are only taken from the store while the bytes queued on the
+    // connection stay below the ideal send buffer size reported by msquic
+
+    // msquic default until QUIC_STREAM_EVENT_IDEAL_SEND_BUFFER_SIZE
+    static constexpr std::uint64_t defaultIdealSendBufferSize = 1 << 17;
+    // passed to StreamSend, SEND_COMPLETE not indicated yet
+    std::atomic<std::uint64_t> bytesInFlight_{};
+    // waiting in sendScheduler_
+    std::atomic<std::uint64_t> scheduledBytes_{};
+    std::atomic<std::uint64_t> idealSendBufferSize_{ defaultIdealSendBufferSize };
+    // set by senders which stopped for lack of budget, cleared by whoever
+    // gives budget back and notifies activityNotifier_
+    std::atomic<bool> sendBlocked_{};
+    // DataManager::activityNotifier_ on the server, subscription threads
+    // park on it, nullptr on the client which has no subscription threads
+    EpochNotifier* activityNotifier_ = nullptr;
+
+    // called on creation and deletion of StreamSendContexts
+    void on_send_started(std::uint64_t numBytes) noexcept;
+    void on_send_completed(std::uint64_t numBytes) noexcept;
+    void set_ideal_send_buffer_size(std::uint64_t idealSendBufferSize) noexcept;
+
+    // room for objects which are not scheduled yet
+    bool has_send_budget() const noexcept
+    {
+        return bytesInFlight_.load(std::memory_order_seq_cst) +
+               scheduledBytes_.load(std::memory_order_seq_cst) <
+               idealSendBufferSize_.load(std::memory_order_relaxed);
+    }
+    // scheduled objects are waiting and msquic can take some of them
+    bool can_flush() const noexcept
+    {
+        return scheduledBytes_.load(std::memory_order_relaxed) != 0 &&
+               bytesInFlight_.load(std::memory_order_relaxed) <
+               idealSendBufferSize_.load(std::memory_order_relaxed);
+    }
+    // nullopt if there is send budget, else a signal which is set once
+    // budget may be back
+    std::optional<WaitSignal> wait_for_send_budget();
+
+    // Stream pool
+    // //////////////////////////////////////////////////////////////
+    // the first object of a group usually is the largest one (keyframe),
+    // its stream is opened and started ahead of time instead of on its path
+
+    struct PooledStream
+    {
+        rvn::unique_stream stream_;
+        StreamContext* streamContext_;
+    };
+
+    static constexpr std::size_t streamPoolSize = 8;
+    std::mutex streamPoolMtx_;
+    std::vector<PooledStream> streamPool_;
+    // being opened by replenish_stream_pool, counted towards the pool
+    std::size_t numPooling_ = 0;
+    // a replenish_stream_pool timer is pending, later sends do not add one
+    bool replenishPending_ = false;
+    // unidirectional streams the peer still lets us open, pooled streams
+    // never exceed it, 0 until QUIC_CONNECTION_EVENT_STREAMS_AVAILABLE
+    std::uint64_t numAvailableStreams_ = 0;
+
+    // opens and starts a unidirectional data stream
+    PooledStream open_data_stream();
+    // a pooled stream if there is one, else a newly opened one, write lock
+    // of dataStreams held
+    PooledStream take_data_stream();
+    // forgets a pooled stream which was shut down before it was taken,
+    // write lock of dataStreams held
+    void drop_pooled_stream(HQUIC streamHandle);
+    // tops the pool up within the stream limit of the peer
+    void replenish_stream_pool();
+    // replenish_stream_pool on the timer thread if the pool is short
+    void schedule_stream_pool_replenish();
+    void set_available_streams(std::uint64_t numAvailableStreams);
+
+    // nodes are pooled, streams come and go with every group
+    using DataStreams = StableContainer<DataStreamState, PoolAllocator<DataStreamState>>;
+    RWProtected<DataStreams> dataStreams;
+    // indices into dataStreams, only touched with its lock held, updated
+    // through add_data_stream and erase_data_stream
+    using DataStreamIterator = DataStreams::iterator;
+    std::unordered_map<HQUIC, DataStreamIterator> dataStreamHandles_;
+    std::unordered_map<DataStreamKey, DataStreamIterator, DataStreamKeyHash> sendStreams_;
+
+    DataStreamState& add_data_stream(DataStreams& dataStreams,
+                                     rvn::unique_stream&& stream,
+                                     std::optional<DataStreamKey> sendKey = std::nullopt);
+    // the stream is handed back to be aborted once the lock of dataStreams
+    // is released, SHUTDOWN_COMPLETE may be indicated inline and frees the
+    // state under the same lock
+    [[nodiscard]] rvn::unique_stream erase_data_stream(DataStreams& dataStreams, DataStreamIterator iter);
+    // objects of the subgroup no longer go on the stream, it stays until
+    // it is shut down, write lock of dataStreams held
+    void unindex_send_stream(DataStreamIterator iter);
+    std::optional<DataStreamIterator> find_data_stream(HQUIC streamHandle) const;
+    std::optional<DataStreamIterator> find_send_stream(const ObjectIdentifier& objectIdentifier) const;
 
     std::optional<StreamState> controlStream;
 
+    // frees the state of a stream which was shut down, pooled or in use,
+    // the caller closes the handle
     void delete_data_stream(HQUIC streamHandle);
     void enqueue_data_buffer(QUIC_BUFFER* buffer);
 
-    QUIC_STATUS
-    send_object(const ObjectIdentifier& objectIdentifier,
-                QUIC_BUFFER* buffer,
-                PublisherPriority publisherPriority,
-                std::optional<std::chrono::milliseconds> timeoutDuration);
+    // objects of one group of a track, in order, sent with a single
+    // StreamSend, payloads are moved out
+    QUIC_STATUS send_objects(std::span<ScheduledObject> scheduledObjects);
+
+    // Datagrams
+    // //////////////////////////////////////////////////////////////
+    // largest datagram the peer takes, 0 while datagrams can not be sent
+    // (QUIC_CONNECTION_EVENT_DATAGRAM_STATE_CHANGED)
+    std::atomic<std::uint16_t> maxDatagramLength_{};
+
+    void set_datagram_state(bool sendEnabled, std::uint16_t maxSendLength) noexcept
+    {
+        maxDatagramLength_.store(sendEnabled ? maxSendLength : 0, std::memory_order_relaxed);
+    }
+
+    // objects of one group of a track, one datagram each. Objects which do
+    // not fit go on the stream of the group, which the end of the group
+    // finishes as usual
+    QUIC_STATUS send_datagrams(std::span<ScheduledObject> scheduledObjects);
+    // handed to the same MessageHandler as objects of data streams
+    void receive_datagram(const QUIC_BUFFER& buffer);
+
+    // objects of every subscription of the connection waiting to be sent
+    std::mutex sendSchedulerMtx_;
+    SendScheduler sendScheduler_;
+    // objects of the send being prepared, reused between flushes
+    std::vector<ScheduledObject> sendRun_;
+    // bounds the objects gathered by one StreamSend
+    static constexpr std::size_t maxObjectsPerSend = StreamSendContext::maxObjectsPerSend;
+    // set from the first schedule_object until the flush
+    std::atomic<bool> flushPending_{};
+
+    // returns true if the caller has to call flush_scheduled_objects
+    bool schedule_object(ScheduledObject scheduledObject, bool supersede = false);
+    // sends the scheduled objects in priority order while there is budget
+    // returns true if objects are left and the caller has to flush again
+    // once can_flush(), false if everything was sent or sending failed
+    bool flush_scheduled_objects();
     void send_control_buffer(QUIC_BUFFER* buffer, QUIC_SEND_FLAGS flags = QUIC_SEND_FLAG_NONE);
     /////////////////////////////////////////////////////////////////////////////
 
@@ -174,6 +416,31 @@ struct ConnectionState : std::enable_shared_from_this<ConnectionState>
     {
     }
 
+    enum class Destruction
+    {
+        // deleted by whoever drops the last reference
+        Direct,
+        // retired to the EpochDomain and destroyed on the timer thread
+        Deferred
+    };
+
+    /*
+        With Destruction::Deferred the state is retired instead of deleted
+        once the last shared_ptr is gone. Threads which pinned the domain and
+        saw a weak_ptr to the connection not expired() can keep dereferencing
+        a raw pointer to it until they unpin, without locking the weak_ptr.
+        The shutdown itself (ConnectionShutdown, stream aborts, ConnectionClose)
+        runs on the timer thread after the grace period, never on whoever
+        dropped the last reference. The server, whose subscription threads
+        hold such raw pointers, defers. The client has no such readers and
+        uses Destruction::Direct.
+    */
+    static std::shared_ptr<ConnectionState> create(unique_connection&& connection,
+                                                   class MOQT& moqtObject,
+                                                   Destruction destruction);
+
+    ~ConnectionState();
+
     std::optional<StreamState>& get_control_stream();
     const std::optional<StreamState>& get_control_stream() const;
 
@@ -183,6 +450,7 @@ struct ConnectionState : std::enable_shared_from_this<ConnectionState>
 
     StreamState& establish_control_stream();
 
+    // aborts the data stream of the group of oid if it has sends in flight
     void abort_if_sending(const ObjectIdentifier& oid);
 };
 
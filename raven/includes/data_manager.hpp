@@ -5,14 +5,19 @@
 #include <boost/functional/hash.hpp>
 #include <chrono>
 #include <cstdint>
+#include <epoch_notifier.hpp>
 #include <functional>
 #include <iostream>
-#include <map>
 #include <memory>
 #include <msquic.h>
+#include <mutex>
 #include <optional>
+#include <segment_log.hpp>
+#include <shared_quic_buffer.hpp>
+#include <span>
 #include <string>
 #include <strong_types.hpp>
+#include <track_store.hpp>
 #include <unordered_map>
 #include <utilities.hpp>
 #include <variant>
@@ -22,39 +27,84 @@ namespace rvn
 {
 // We could not find the object requested
 
+/*
+    Interns track identifiers, every (namespace, name) is stored once and
+    resolves to a dense TrackId. Entries are never freed, a TrackIdentifier is
+    just a pointer to its entry so copying, hashing and comparing it is a
+    single word operation.
+    Sharded by hash so that tracks can be created concurrently.
+*/
+class TrackIdentifierRegistry
+{
+public:
+    struct Entry
+    {
+        TrackId trackId_;
+        std::uint64_t hash_;
+        std::vector<std::string> tnamespace_;
+        std::string tname_;
+    };
+
+private:
+    // hash -> entries with that hash, nodes never move
+    using Entries = std::unordered_multimap<std::uint64_t, Entry>;
+
+    ShardedRWProtected<Entries> entries_;
+    std::atomic<std::uint64_t> nextTrackId_{};
+
+    static const Entry* find(const Entries& entries,
+                             std::uint64_t hash,
+                             const std::vector<std::string>& tracknamespace,
+                             const std::string& trackname);
+
+public:
+    static std::uint64_t hash(const std::vector<std::string>& tracknamespace,
+                              const std::string& trackname);
+
+    const Entry& intern(std::vector<std::string> tracknamespace, std::string trackname);
+
+    std::uint64_t size() const noexcept;
+};
+
+DECLARE_SINGLETON(TrackIdentifierRegistry)
+
 class TrackIdentifier
 {
-    std::shared_ptr<std::pair<std::vector<std::string>, std::string>> trackIdentifierInternal_;
+    // interned, never freed
+    const TrackIdentifierRegistry::Entry* entry_;
 
 public:
     struct Hash
     {
-        std::uint64_t operator()(const TrackIdentifier& id) const
+        std::uint64_t operator()(const TrackIdentifier& id) const noexcept
         {
-            std::uint64_t hash = 0;
-            for (const auto& ns : id.tnamespace())
-                boost::hash_combine(hash, ns);
-
-            boost::hash_combine(hash, id.tname());
-            return hash;
+            return id.hash();
         }
     };
     using Equal = std::equal_to<TrackIdentifier>;
 
     const std::vector<std::string>& tnamespace() const noexcept
     {
-        return trackIdentifierInternal_->first;
+        return entry_->tnamespace_;
     }
     const std::string& tname() const noexcept
     {
-        return trackIdentifierInternal_->second;
+        return entry_->tname_;
+    }
+    TrackId track_id() const noexcept
+    {
+        return entry_->trackId_;
+    }
+    std::uint64_t hash() const noexcept
+    {
+        return entry_->hash_;
     }
 
     TrackIdentifier(std::vector<std::string> tracknamespace, std::string trackname);
 
-    bool operator==(const TrackIdentifier& other) const
+    bool operator==(const TrackIdentifier& other) const noexcept
     {
-        return tnamespace() == other.tnamespace() && tname() == other.tname();
+        return entry_ == other.entry_;
     }
 
     friend inline std::ostream& operator<<(std::ostream& os, const TrackIdentifier& id)
@@ -117,7 +167,8 @@ class Object
 
 public:
     // should be read only if flags_ == 0
-    QUIC_BUFFER* payload_;
+    // shared with every in-flight send of the object
+    SharedQuicBuffer payload_;
 
     std::optional<std::chrono::milliseconds> deliveryTimeout_;
 
@@ -131,34 +182,79 @@ public:
     bool is_valid_group() const noexcept{ return flag_ == 0;}
     // clang-format on
 
-    Object(QUIC_BUFFER* payload,
+    Object(SharedQuicBuffer payload,
            std::optional<std::chrono::milliseconds> deliveryTimeout = std::nullopt)
-    : flag_(0), payload_(payload), deliveryTimeout_(deliveryTimeout)
+    : flag_(0), payload_(std::move(payload)), deliveryTimeout_(deliveryTimeout)
+    {
+    }
+
+    Object(GroupTerminator) : flag_(GroupTerminator::flag_)
     {
     }
 
-    Object(GroupTerminator) : flag_(GroupTerminator::flag_), payload_(nullptr)
+    Object(TrackTerminator) : flag_(TrackTerminator::flag_)
     {
     }
 
-    Object(TrackTerminator) : flag_(TrackTerminator::flag_), payload_(nullptr)
+    // payloads are stored as a serialized StreamHeaderSubgroupObject, sent
+    // as they are on the stream of their group
+    static SharedQuicBuffer serialize_payload(ObjectId objectId, std::string data)
     {
+        StreamHeaderSubgroupObject subgroupObject;
+        subgroupObject.objectId_ = objectId;
+        subgroupObject.payload_ = std::move(data);
+
+        return SharedQuicBuffer::adopt(serialization::serialize(subgroupObject));
+    }
+
+    // past the leading object id, the payload length and payload which
+    // OBJECT_DATAGRAM shares with StreamHeaderSubgroupObject
+    static std::uint32_t payload_length_offset(const SharedQuicBuffer& payload) noexcept
+    {
+        return std::uint32_t(1) << (payload->Buffer[0] >> 6);
     }
 };
 
+template <> struct TrackStoreTraits<Object>
+{
+    static std::uint64_t size(const Object& object) noexcept
+    {
+        return object.payload_ ? object.payload_->Length : 0;
+    }
+
+    // drops the reference of the store, in-flight sends keep the payload alive
+    static void destroy(Object& object) noexcept
+    {
+        object.~Object();
+    }
+};
+
+/*
+    Retention limits, a track evicts its oldest groups once any limit is
+    exceeded. Eviction is group granular and never evicts the latest group of
+    a track as the publisher is still appending to it.
+    When passed to the DataManager, maxGroups_ and maxBytes_ bound the sum over
+    all tracks and maxAge_ applies to every track which does not set its own.
+*/
+struct RetentionPolicy
+{
+    std::optional<std::uint64_t> maxGroups_;
+    std::optional<std::uint64_t> maxBytes_;
+    std::optional<std::chrono::milliseconds> maxAge_;
+};
+
 /*
-    Used to signal if the object has published and can be read
-    Returned when the object is not found,
-    and we do not want the reader to keep querying on a spin loop
-    as it causes R/W contention and too many seq cst atomic operations
+    Objects are written through to an append only segment log per track in
+    dataDirectory_/<namespace>/<track>/, groups evicted from memory are then
+    served from the log and tracks survive restarts.
+    Tracks are kept in memory only if dataDirectory_ is not set.
 */
-enum class WaitStatus
+struct StoragePolicy
 {
-    Wait,
-    Ready
+    std::optional<std::string> dataDirectory_;
+    SegmentLogOptions segmentLogOptions_;
 };
-// TODO: possibly make wait signals strong types
-using WaitSignal = std::shared_ptr<std::atomic<WaitStatus>>;
+
 using EnrichedObjectType = std::tuple<GroupId, ObjectId, Object>;
 using EnrichedObjectOrWait = std::variant<std::monostate, EnrichedObjectType, WaitSignal>;
 class TrackHandle : public std::enable_shared_from_this<TrackHandle>
@@ -173,59 +269,95 @@ public:
 private:
     PublisherPriority publisherPriority_;
     std::optional<std::chrono::milliseconds> deliveryTimeout_;
+    RetentionPolicy retentionPolicy_;
+
+    // nullptr if the track is not persisted
+    std::unique_ptr<SegmentLog> segmentLog_;
+    // groups with id < coldGroupEnd_ are evicted (or were not reloaded after a
+    // restart) and are served from segmentLog_
+    std::atomic<std::uint64_t> coldGroupEnd_{};
+
+    // groups created since the last publish_objects, handed to the
+    // DataManager as eviction candidates once mtx_ is released, guarded by
+    // mtx_
+    std::vector<GroupId> newGroups_;
+
+    // publishers must hold mtx_
+    bool emplace_object(GroupId groupId, ObjectId objectId, Object object);
+    // emplaces, persists and signals, returns false on duplicates
+    bool publish_object(GroupId groupId, ObjectId objectId, Object object);
+    // publish_object for a batch under a single lock acquisition and a single
+    // wake up, returns the number of objects which were not duplicates
+    std::uint64_t publish_objects(std::span<EnrichedObjectType> objects);
+    // reloads the latest group of segmentLog_ into objects_
+    void reload_latest_group();
+    // cold object, lives as long as segmentLog_
+    EnrichedObjectType make_cold_object(const SegmentLog::Record& record) const;
+    // evicts oldest groups exceeding the retention policy, must hold mtx_
+    void enforce_retention();
+    // evicts the oldest group if it is not the latest group, must hold mtx_
+    bool evict_oldest_group();
 
 public:
-    std::mutex mtx_; // protects objects_, update signal
+    std::mutex mtx_; // serializes publishers, readers do not lock
     // total order established by group id + object id
-    std::map<std::tuple<GroupId, ObjectId>, Object> objects_;
-    WaitSignal updateSignal_;
+    TrackStore<Object> objects_;
+    // bumped after every publish, readers must observe the epoch (construct
+    // the WaitSignal) before looking up objects_
+    // unique_ptr because it may be adopted from a pending DataManager entry
+    std::unique_ptr<EpochNotifier> updateNotifier_;
 
     // should be private but want to use std::make_shared
     TrackHandle(DataManager& dataManagerHandle,
                 TrackIdentifier trackIdentifier,
                 PublisherPriority publisherPriority,
-                std::optional<std::chrono::milliseconds> deliveryTimeout);
+                std::optional<std::chrono::milliseconds> deliveryTimeout,
+                RetentionPolicy retentionPolicy,
+                std::unique_ptr<EpochNotifier> updateNotifier);
 
     TrackHandle& operator=(const TrackHandle&) = delete;
     TrackHandle& operator=(TrackHandle&&) = delete;
 
+    // publishers must hold mtx_
+    void signal_update();
+
     EnrichedObjectOrWait get_first_object();
     EnrichedObjectOrWait get_next_object(const ObjectIdentifier& objectIdentifier);
     EnrichedObjectOrWait get_latest_object(const std::optional<ObjectIdentifier>& oid);
+    // first object at or after (groupId, objectId), positions subscriptions
+    // starting in the middle of the track without walking from the first object
+    EnrichedObjectOrWait get_object_at_or_after(GroupId groupId, ObjectId objectId);
+    // nullopt if nothing was published yet
+    std::optional<GroupId> latest_group_id() const;
 
     void add_object(GroupId groupId, ObjectId objectId, Object::GroupTerminator)
     {
-        std::unique_lock l(mtx_);
-        objects_.emplace(std::make_tuple(groupId, objectId),
-                         Object{ Object::GroupTerminator{} });
-        updateSignal_->store(WaitStatus::Ready, std::memory_order::release);
-        updateSignal_ = std::make_shared<std::atomic<WaitStatus>>(WaitStatus::Wait);
+        publish_object(groupId, objectId, Object::GroupTerminator{});
     }
 
     void add_object(GroupId groupId, ObjectId objectId, Object::TrackTerminator)
     {
-        std::unique_lock l(mtx_);
-        objects_.emplace(std::make_tuple(groupId, objectId),
-                         Object{ Object::TrackTerminator{} });
-        updateSignal_->store(WaitStatus::Ready, std::memory_order::release);
-        updateSignal_ = std::make_shared<std::atomic<WaitStatus>>(WaitStatus::Wait);
+        publish_object(groupId, objectId, Object::TrackTerminator{});
     }
 
     void add_object(GroupId groupId, ObjectId objectId, std::string data)
     {
-        StreamHeaderSubgroupObject subgroupObject;
-        subgroupObject.objectId_ = objectId;
-        subgroupObject.payload_ = std::move(data);
-
-        QUIC_BUFFER* quicBuffer = serialization::serialize(subgroupObject);
-        std::unique_lock l(mtx_);
-        objects_.emplace(std::make_tuple(groupId, objectId), Object{ quicBuffer });
-        updateSignal_->store(WaitStatus::Ready, std::memory_order::release);
-        updateSignal_ = std::make_shared<std::atomic<WaitStatus>>(WaitStatus::Wait);
+        publish_object(groupId, objectId, Object::serialize_payload(objectId, std::move(data)));
     }
-};
 
-// TODO: Read and make use of https://www.sqlite.org/fasterthanfs.html
+    /*
+        Publishes several objects at once (e.g. every layer of a frame).
+        Payloads are serialized before taking mtx_, subscribers are woken up
+        once for the whole batch. Duplicates are skipped, payloads are moved
+        from. Returns the number of objects published.
+    */
+    using ObjectBatchEntry = std::tuple<GroupId, ObjectId, std::string>;
+    std::uint64_t add_objects(std::span<ObjectBatchEntry> objects);
+
+private:
+    // must not hold mtx_
+    void enforce_global_retention();
+};
 
 class DataManager
 {
@@ -233,30 +365,80 @@ class DataManager
     friend class GroupHandle;
     friend class TrackHandle;
 
-    RWProtected<std::unordered_map<TrackIdentifier, std::shared_ptr<TrackHandle>, TrackIdentifier::Hash, TrackIdentifier::Equal>> trackHandles_;
-    RWProtected<std::unordered_map<TrackIdentifier, WaitSignal, TrackIdentifier::Hash, TrackIdentifier::Equal>> trackWaitSignals_;
+    struct TrackEntry
+    {
+        // nullptr until the track is added
+        std::shared_ptr<TrackHandle> trackHandle_;
+        // subscribers wait on it until the track is added, then it is
+        // adopted by the TrackHandle
+        std::unique_ptr<EpochNotifier> pendingNotifier_;
+    };
+    // sharded by TrackIdentifier::hash
+    ShardedRWProtected<std::unordered_map<TrackIdentifier, TrackEntry, TrackIdentifier::Hash, TrackIdentifier::Equal>> tracks_;
+
+    RetentionPolicy globalRetentionPolicy_;
+    StoragePolicy storagePolicy_;
+    // sums over all tracks, updated by publishers
+    std::atomic<std::uint64_t> numBytes_{};
+    std::atomic<std::uint64_t> numGroups_{};
+    struct EvictionCandidate
+    {
+        std::chrono::steady_clock::time_point publishedAt_;
+        std::weak_ptr<TrackHandle> trackHandle_;
+        GroupId groupId_;
+
+        bool operator>(const EvictionCandidate& other) const noexcept
+        {
+            return publishedAt_ > other.publishedAt_;
+        }
+    };
+
+    // only one publisher evicts for the global limits at a time, also
+    // guards evictionCandidates_, taken before TrackHandle::mtx_
+    std::mutex globalEvictionMtx_;
+    // min-heap by publishedAt_ of the groups in memory, only kept if there
+    // are global limits. Groups evicted by the limits of their track are
+    // skipped once they come up
+    std::vector<EvictionCandidate> evictionCandidates_;
+
+    bool has_global_limits() const noexcept;
+    bool exceeds_global_retention() const noexcept;
+    void enforce_global_retention();
+    // must not hold trackHandle.mtx_
+    void add_eviction_candidates(const std::shared_ptr<TrackHandle>& trackHandle,
+                                 std::span<const GroupId> groupIds);
+    // drops the candidates of evicted groups and of removed tracks, must
+    // hold globalEvictionMtx_
+    void compact_eviction_candidates();
 
     std::string get_path_string(const TrackIdentifier& trackIdentifier);
-    std::string get_path_string(const GroupIdentifier& groupIdentifier);
-    std::string get_path_string(const ObjectIdentifier& objectIdentifier);
 
-    bool store_object(const GroupIdentifier& groupIdentifier,
-                      ObjectId objectId,
-                      std::string&& object);
+    // appends the object to the segment log of the track, publisher must hold
+    // trackHandle.mtx_, returns false if the track is not persisted
+    bool store_object(TrackHandle& trackHandle, GroupId groupId, ObjectId objectId, const Object& object);
 
 public:
     std::weak_ptr<TrackHandle>
     add_track_identifier(std::vector<std::string> tracknamespace,
                          std::string trackname,
                          PublisherPriority publisherPriority,
-                         std::optional<std::chrono::milliseconds> deliveryTimeout);
+                         std::optional<std::chrono::milliseconds> deliveryTimeout,
+                         RetentionPolicy retentionPolicy = {});
 
     std::variant<std::shared_ptr<TrackHandle>, WaitSignal>
     get_track_handle(const TrackIdentifier& trackIdentifier);
 
+    // nullptr if the track has not been added
+    std::shared_ptr<TrackHandle> find_track_handle(const TrackIdentifier& trackIdentifier) const;
+
     PublisherPriority get_track_publisher_priority(const TrackIdentifier& trackIdentifier);
 
-    DataManager()
+    // bumped after every publish to any track and whenever a track is added,
+    // idle subscription threads park on it
+    EpochNotifier activityNotifier_;
+
+    DataManager(RetentionPolicy globalRetentionPolicy = {}, StoragePolicy storagePolicy = {})
+    : globalRetentionPolicy_(globalRetentionPolicy), storagePolicy_(std::move(storagePolicy))
     {
     }
 };
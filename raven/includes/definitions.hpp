@@ -1,14 +1,18 @@
 #pragma once
 
+#include <bit>
 #include <blockingconcurrentqueue.h>
 #include <chrono>
+#include <cstdint>
 #include <list>
+#include <memory>
 #include <shared_mutex>
 #include <utility>
 
 namespace rvn
 {
-template <typename T> using StableContainer = std::list<T>;
+template <typename T, typename Allocator = std::allocator<T>>
+using StableContainer = std::list<T, Allocator>;
 
 // wrapper class for tsan suppressions
 template <typename T> class MPMCQueue
@@ -74,6 +78,52 @@ public:
     }
 };
 
+/*
+    RWProtected split into independently locked shards, the shard is picked
+    by the hash of the key. Operations on keys in different shards never
+    touch the same lock (or cache line).
+    f must only access the key(s) which map to the selected shard.
+*/
+template <typename T, std::size_t NumShards = 256> class ShardedRWProtected
+{
+    static_assert(std::has_single_bit(NumShards));
+
+    struct alignas(64) Shard
+    {
+        RWProtected<T> data_;
+    };
+
+    std::unique_ptr<Shard[]> shards_;
+
+    std::size_t shard_index(std::uint64_t hash) const noexcept
+    {
+        // fibonacci hashing, callers may pass weak hashes (dense ids)
+        return (hash * 0x9e3779b97f4a7c15ull) >> (64 - std::countr_zero(NumShards));
+    }
+
+public:
+    ShardedRWProtected() : shards_(std::make_unique<Shard[]>(NumShards))
+    {
+    }
+
+    template <typename F> decltype(auto) read(std::uint64_t hash, F&& f) const noexcept
+    {
+        return shards_[shard_index(hash)].data_.read(std::forward<F>(f));
+    }
+
+    template <typename F> decltype(auto) write(std::uint64_t hash, F&& f) noexcept
+    {
+        return shards_[shard_index(hash)].data_.write(std::forward<F>(f));
+    }
+
+    // read locks one shard at a time, not a consistent snapshot
+    template <typename F> void for_each_shard(F&& f) const noexcept
+    {
+        for (std::size_t i = 0; i < NumShards; i++)
+            shards_[i].data_.read(f);
+    }
+};
+
 using Clock = std::chrono::steady_clock;
 using TimePoint = std::chrono::time_point<Clock>;
 
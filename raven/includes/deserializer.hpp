@@ -252,6 +252,22 @@ template <typename DeserializedMessageHandler> class Deserializer
         read_subgroup_object();
     }
 
+    // caller checked that payloadLength bytes are available
+    std::string read_payload(std::uint64_t payloadLength)
+    {
+        std::string payload;
+        payload.reserve(payloadLength);
+        for (std::uint64_t i = 0; i < payloadLength;)
+        {
+            auto bytes = chunked_at(i, payloadLength - i);
+            i += bytes.size();
+            for (const auto& byte : bytes)
+                payload.push_back(byte);
+        }
+        bytes_deserialized_hook(payloadLength);
+        return payload;
+    }
+
     /*
         {
           Object ID = 0
@@ -282,16 +298,7 @@ template <typename DeserializedMessageHandler> class Deserializer
         if (size() < subGroupObjectPayloadLength_)
             return;
 
-        std::string payload;
-        payload.reserve(subGroupObjectPayloadLength_.value());
-        for (std::uint64_t i = 0; i < *subGroupObjectPayloadLength_;)
-        {
-            auto bytes = chunked_at(i, *subGroupObjectPayloadLength_ - i);
-            i += bytes.size();
-            for (const auto& byte : bytes)
-                payload.push_back(byte);
-        }
-        bytes_deserialized_hook(subGroupObjectPayloadLength_.value());
+        std::string payload = read_payload(*subGroupObjectPayloadLength_);
 
         auto msg =
         StreamHeaderSubgroupObject{ subGroupObjectId_.value(), std::move(payload) };
@@ -303,6 +310,82 @@ template <typename DeserializedMessageHandler> class Deserializer
         read_subgroup_object();
     }
 
+    /*
+        OBJECT_DATAGRAM Message {
+          Track Alias (i),
+          Group ID (i),
+          Object ID (i),
+          Publisher Priority (8),
+          Object Payload Length (i),
+          Object Payload (..),
+        }
+        A whole object, the header of the next message may follow
+    */
+    std::optional<PublisherPriority> publisherPriority_;
+    void read_object_datagram()
+    {
+        if (!trackAlias_.has_value())
+        {
+            std::uint64_t trackAliasInt = read_quic_var_int();
+            if (trackAliasInt == std::numeric_limits<std::uint64_t>::max())
+                return;
+            trackAlias_ = TrackAlias(trackAliasInt);
+        }
+
+        if (!groupId_.has_value())
+        {
+            std::uint64_t groupIdInt = read_quic_var_int();
+            if (groupIdInt == std::numeric_limits<std::uint64_t>::max())
+                return;
+            groupId_ = GroupId(groupIdInt);
+        }
+
+        if (!subGroupObjectId_.has_value())
+        {
+            std::uint64_t objectId = read_quic_var_int();
+            if (objectId == std::numeric_limits<std::uint64_t>::max())
+                return;
+            subGroupObjectId_ = ObjectId(objectId);
+        }
+
+        if (!publisherPriority_.has_value())
+        {
+            if (size() < sizeof(std::uint8_t))
+                return;
+            publisherPriority_ = PublisherPriority(at(0));
+            bytes_deserialized_hook(1);
+        }
+
+        if (!subGroupObjectPayloadLength_.has_value())
+        {
+            std::uint64_t objectPayloadLength = read_quic_var_int();
+            if (objectPayloadLength == std::numeric_limits<std::uint64_t>::max())
+                return;
+            subGroupObjectPayloadLength_ = objectPayloadLength;
+        }
+
+        if (size() < subGroupObjectPayloadLength_)
+            return;
+
+        std::string payload = read_payload(*subGroupObjectPayloadLength_);
+
+        auto msg = ObjectDatagramMessage{ { trackAlias_.value(), groupId_.value(),
+                                            subGroupObjectId_.value(),
+                                            publisherPriority_.value() },
+                                          std::move(payload) };
+        messageHandler_(std::move(msg));
+
+        trackAlias_ = std::nullopt;
+        groupId_ = std::nullopt;
+        subGroupObjectId_ = std::nullopt;
+        publisherPriority_ = std::nullopt;
+        subGroupObjectPayloadLength_ = std::nullopt;
+        dataStreamHeaderId_ = std::nullopt;
+
+        state_ = DeserializerState::READING_OBJECT_HEADER;
+        read_object_header();
+    }
+
     std::optional<ObjectStreamHeaderType> dataStreamHeaderId_;
     void read_object_header()
     {
@@ -322,9 +405,16 @@ template <typename DeserializedMessageHandler> class Deserializer
                 read_subgroup_header();
                 break;
             }
+            case ObjectStreamHeaderType::OBJECT_DATAGRAM:
+            {
+                // no stream header, every datagram carries its own
+                state_ = DeserializerState::READING_OBJECT_DATAGRAM;
+                read_object_datagram();
+                return;
+            }
             default:
             {
-                // TODO handle OBJECT_DATAGRAM_HEADER and FETCH_HEADER
+                // TODO handle FETCH_HEADER
                 utils::ASSERT_LOG_THROW(false, "Invalid object header",
                                         utils::to_underlying(dataStreamHeaderId_.value()));
             }
@@ -337,7 +427,7 @@ template <typename DeserializedMessageHandler> class Deserializer
             // read the object header
             state_ = DeserializerState::READING_SUBGROUP_OBJECT;
         else
-            // TODO handle OBJECT_DATAGRAM_HEADER and FETCH_HEADER
+            // TODO handle FETCH_HEADER
             utils::ASSERT_LOG_THROW(false, "Invalid object header",
                                     utils::to_underlying(dataStreamHeaderId_.value()));
     }
@@ -369,8 +459,10 @@ template <typename DeserializedMessageHandler> class Deserializer
                     read_object_header();
                 else if (state_ == DeserializerState::READING_SUBGROUP_OBJECT)
                     read_subgroup_object();
+                else if (state_ == DeserializerState::READING_OBJECT_DATAGRAM)
+                    read_object_datagram();
                 else
-                    // TOOD: implement reading OBJECT_DATAGRAM and and FETCH_HEADER
+                    // TOOD: implement reading FETCH_HEADER
                     utils::ASSERT_LOG_THROW(false, "Invalid state",
                                             utils::to_underlying(state_));
                 break;
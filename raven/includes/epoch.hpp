@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utilities.hpp>
+#include <vector>
+
+namespace rvn
+{
+/*
+    Epoch based reclamation
+
+    Readers pin the domain (EpochDomain::Guard) while they traverse shared
+    structures without holding any lock. Writers unlink nodes first and then
+    retire them, the retired node is destroyed once every reader which could
+    have observed it has unpinned.
+
+    Each retire advances the global epoch, a node retired at epoch r can be
+    freed once every pinned reader has announced an epoch > r.
+
+    NOTE: a domain must outlive every thread which pinned it
+*/
+class EpochDomain
+{
+public:
+    struct alignas(64) ThreadRecord
+    {
+        // epoch announced when the reader pinned, 0 if not pinned
+        std::atomic<std::uint64_t> epoch_{};
+        std::atomic<bool> inUse_{};
+        // only touched by the owning thread
+        std::uint32_t nesting_{};
+        ThreadRecord* next_{};
+    };
+
+private:
+    struct Retired
+    {
+        std::uint64_t epoch_;
+        void* ptr_;
+        void (*deleter_)(void*);
+    };
+
+    // reclaim is attempted every reclaimThreshold retires
+    static constexpr std::uint64_t reclaimThreshold = 64;
+
+    std::atomic<std::uint64_t> globalEpoch_{ 1 };
+    // records are never freed, threads which exit hand them to new threads
+    std::atomic<ThreadRecord*> records_{};
+
+    std::mutex retiredMtx_;
+    std::vector<Retired> retired_;
+    // retire_deferred, only destroyed by reclaim_deferred
+    std::vector<Retired> deferred_;
+    std::atomic<std::uint64_t> numDeferred_{};
+
+    ThreadRecord* acquire_record();
+    std::uint64_t min_pinned_epoch() const noexcept;
+
+public:
+    class Guard
+    {
+        ThreadRecord* record_;
+
+    public:
+        Guard(EpochDomain& domain) : record_(domain.thread_record())
+        {
+            if (record_->nesting_++ == 0)
+            {
+                record_->epoch_.store(domain.globalEpoch_.load(std::memory_order_relaxed),
+                                      std::memory_order_relaxed);
+                // announcement must be visible before any shared pointer is read
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        ~Guard()
+        {
+            if (--record_->nesting_ == 0)
+                record_->epoch_.store(0, std::memory_order_release);
+        }
+    };
+
+    ThreadRecord* thread_record();
+
+    // ptr must already be unreachable for readers which pin after this call
+    void retire(void* ptr, void (*deleter)(void*));
+
+    template <typename T> void retire(T* ptr)
+    {
+        retire(static_cast<void*>(ptr),
+               [](void* ptr) { delete static_cast<T*>(ptr); });
+    }
+
+    // destroys every retired node which no pinned reader can observe
+    void reclaim();
+
+    // like retire but the node is never destroyed by the retiring thread or
+    // by reclaim, for nodes whose destructor must not run inside whatever
+    // dropped them (it may hold locks or be a msquic worker)
+    void retire_deferred(void* ptr, void (*deleter)(void*));
+
+    template <typename T> void retire_deferred(T* ptr)
+    {
+        retire_deferred(static_cast<void*>(ptr),
+                        [](void* ptr) { delete static_cast<T*>(ptr); });
+    }
+
+    // destroys the deferred nodes which no pinned reader can observe, called
+    // without holding any lock and without a Guard of this thread. Returns
+    // false while some deferred nodes are still pinned
+    bool reclaim_deferred();
+
+    ~EpochDomain();
+};
+
+DECLARE_SINGLETON(EpochDomain)
+} // namespace rvn
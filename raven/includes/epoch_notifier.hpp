@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace rvn
+{
+/*
+    Monotonically increasing publish epoch
+
+    Publishers bump the epoch after making an update visible, readers remember
+    the epoch they observed before looking for the update and compare it later.
+    Notifying costs a single atomic increment, the futex wake (atomic::notify)
+    is only issued when some thread is parked on the notifier.
+*/
+class EpochNotifier
+{
+    // 32 bit so that atomic::wait maps directly onto a futex
+    std::atomic<std::uint32_t> epoch_{};
+    mutable std::atomic<std::uint32_t> numParked_{};
+
+public:
+    std::uint32_t epoch(std::memory_order order = std::memory_order_acquire) const noexcept
+    {
+        return epoch_.load(order);
+    }
+
+    void notify() noexcept
+    {
+        // seq cst pairs with park, either the parked thread observes the new
+        // epoch or we observe the parked thread
+        epoch_.fetch_add(1, std::memory_order_seq_cst);
+        if (numParked_.load(std::memory_order_seq_cst) != 0) [[unlikely]]
+            epoch_.notify_all();
+    }
+
+    // blocks until the epoch differs from observedEpoch
+    void park(std::uint32_t observedEpoch) const noexcept
+    {
+        numParked_.fetch_add(1, std::memory_order_seq_cst);
+        epoch_.wait(observedEpoch, std::memory_order_acquire);
+        numParked_.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
+
+/*
+    Used to signal if the object has published and can be read
+    Returned when the object is not found,
+    and we do not want the reader to keep querying on a spin loop
+    as it causes R/W contention and too many seq cst atomic operations
+
+    A wait signal is the epoch of a notifier observed before the lookup which
+    failed, it is ready once the notifier has moved past that epoch.
+    The notifier must outlive the signal, track notifiers live as long as the
+    TrackHandle.
+*/
+class WaitSignal
+{
+    const EpochNotifier* notifier_;
+    std::uint32_t observedEpoch_;
+
+public:
+    explicit WaitSignal(const EpochNotifier& notifier) noexcept
+    : notifier_(&notifier), observedEpoch_(notifier.epoch())
+    {
+    }
+
+    // relaxed checks are enough for polling loops, do an acquire check
+    // before reading the published data
+    bool is_ready(std::memory_order order = std::memory_order_acquire) const noexcept
+    {
+        return notifier_->epoch(order) != observedEpoch_;
+    }
+
+    void wait() const noexcept
+    {
+        notifier_->park(observedEpoch_);
+    }
+
+    const EpochNotifier& notifier() const noexcept
+    {
+        return *notifier_;
+    }
+
+    std::uint32_t observed_epoch() const noexcept
+    {
+        return observedEpoch_;
+    }
+};
+} // namespace rvn
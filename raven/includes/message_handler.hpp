@@ -18,6 +18,7 @@ public:
     void operator()(SubscribeMessage subscribeMessage);
     void operator()(StreamHeaderSubgroupObject streamHeaderSubgroupObject);
     void operator()(StreamHeaderSubgroupMessage streamHeaderSubgroupMessage);
+    void operator()(ObjectDatagramMessage objectDatagramMessage);
     void operator()(BatchSubscribeMessage batchSubscribeMessage);
 };
 } // namespace rvn
@@ -34,7 +34,7 @@ public:
     MPMCQueue<DataStreamUserHandle> dataStreamUserHandles_;
 
     // Alternative deliever method where we enqueue all received objects into a
-    // single queue
+    // single queue, the only one objects received in datagrams go to
     struct EnrichedObjectMessage
     {
         std::shared_ptr<StreamHeaderSubgroupMessage> header_;
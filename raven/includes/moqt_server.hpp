@@ -26,6 +26,7 @@ public:
     MOQTServer(std::shared_ptr<DataManager> dataManager,
                std::tuple<QUIC_GLOBAL_EXECUTION_CONFIG*, std::uint64_t> execConfigTuple = {
                nullptr, 0 });
+    ~MOQTServer();
 
     void start_listener(QUIC_ADDR* LocalAddress);
 
@@ -56,10 +57,13 @@ public:
 
         unique_connection connection = unique_connection(tbl.get(), connectionHandle);
 
+        auto connectionState = ConnectionState::create(std::move(connection), *this,
+                                                       ConnectionState::Destruction::Deferred);
+        // subscription threads park on it, woken when send budget is back
+        connectionState->activityNotifier_ = &dataManager_->activityNotifier_;
+
         std::unique_lock l(connectionStateMapMtx);
-        connectionStateMap.emplace(connectionHandle,
-                                   std::make_shared<ConnectionState>(std::move(connection),
-                                                                     *this));
+        connectionStateMap.emplace(connectionHandle, std::move(connectionState));
 
         return QUIC_STATUS_SUCCESS;
     }
@@ -79,6 +83,34 @@ public:
         return connectionState.accept_control_stream(newStreamInfo.Stream);
     }
 
+    // the peer lets us open more unidirectional streams, data streams are
+    // pre-opened within that limit
+    void set_available_streams(HQUIC connection, std::uint64_t numAvailableStreams)
+    {
+        std::shared_ptr<ConnectionState> connectionState;
+        {
+            std::shared_lock l(connectionStateMapMtx);
+            auto iter = connectionStateMap.find(connection);
+            if (iter == connectionStateMap.end())
+                return;
+            connectionState = iter->second;
+        }
+        connectionState->set_available_streams(numAvailableStreams);
+    }
+
+    void set_datagram_state(HQUIC connection, bool sendEnabled, std::uint16_t maxSendLength)
+    {
+        std::shared_ptr<ConnectionState> connectionState;
+        {
+            std::shared_lock l(connectionStateMapMtx);
+            auto iter = connectionStateMap.find(connection);
+            if (iter == connectionStateMap.end())
+                return;
+            connectionState = iter->second;
+        }
+        connectionState->set_datagram_state(sendEnabled, maxSendLength);
+    }
+
     void cleanup_connection(HQUIC connection)
     {
         std::unique_lock l(connectionStateMapMtx);
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace rvn
+{
+/*
+    Recycles the slots of objects which are allocated on one thread and
+    freed on another, StreamSendContexts are created by whoever sends and
+    deleted on msquic workers, which defeats malloc's thread caches.
+
+    Freed slots are pushed on a shared lock free stack. Allocating threads
+    take the whole stack at once into a thread local cache and hand slots
+    out of it without atomics. Only ever taking the whole stack, never
+    popping single slots, keeps the stack free of ABA.
+
+    Slots are never given back to the system, the pool stays as large as
+    the most objects alive at once.
+*/
+template <typename T> class ObjectPool
+{
+    union Slot
+    {
+        Slot* next_;
+        alignas(T) std::byte storage_[sizeof(T)];
+    };
+
+    static inline std::atomic<Slot*> freed_{};
+
+    struct LocalCache
+    {
+        Slot* head_ = nullptr;
+
+        // slots of exiting threads go back to the shared stack
+        ~LocalCache()
+        {
+            while (head_ != nullptr)
+                push(std::exchange(head_, head_->next_));
+        }
+    };
+
+    static inline thread_local LocalCache localCache_;
+
+    static void push(Slot* slot) noexcept
+    {
+        slot->next_ = freed_.load(std::memory_order_relaxed);
+        while (!freed_.compare_exchange_weak(slot->next_, slot, std::memory_order_release,
+                                             std::memory_order_relaxed))
+            ;
+    }
+
+public:
+    static void* allocate()
+    {
+        LocalCache& localCache = localCache_;
+        if (localCache.head_ == nullptr) [[unlikely]]
+        {
+            localCache.head_ = freed_.exchange(nullptr, std::memory_order_acquire);
+            if (localCache.head_ == nullptr)
+                return ::operator new(sizeof(Slot), std::align_val_t(alignof(Slot)));
+        }
+        return std::exchange(localCache.head_, localCache.head_->next_);
+    }
+
+    static void deallocate(void* ptr) noexcept
+    {
+        push(static_cast<Slot*>(ptr));
+    }
+};
+
+// allocator of node based containers, nodes come from an ObjectPool
+template <typename T> struct PoolAllocator
+{
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+    template <typename U> PoolAllocator(const PoolAllocator<U>&) noexcept
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        if (n != 1) [[unlikely]]
+            return std::allocator<T>{}.allocate(n);
+        return static_cast<T*>(ObjectPool<T>::allocate());
+    }
+
+    void deallocate(T* ptr, std::size_t n) noexcept
+    {
+        if (n != 1) [[unlikely]]
+            std::allocator<T>{}.deallocate(ptr, n);
+        else
+            ObjectPool<T>::deallocate(ptr);
+    }
+
+    template <typename U> bool operator==(const PoolAllocator<U>&) const noexcept
+    {
+        return true;
+    }
+};
+} // namespace rvn
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace rvn
+{
+/*
+    Run queue of a worker thread which other workers can steal from
+
+    tasks_ is only touched by the owner. A worker which ran out of work asks
+    a loaded worker for some (request_steal), the owner answers at the end of
+    its round by moving tasks weighing about half of the load difference
+    into the inbox of the thief (donate_to). Queues hold pointers, the tasks
+    are owned by a storage shared by the workers (SegmentedVector) and keep
+    their address when they move between workers.
+
+    The load of a queue is the summed recent weight of its tasks, it is
+    maintained by the owner (set_load) and only used as a hint.
+*/
+template <typename Task> class RunQueue
+{
+public:
+    static constexpr std::size_t noThief = std::numeric_limits<std::size_t>::max();
+
+private:
+    std::mutex inboxMtx_;
+    std::vector<Task*> inbox_;
+    std::atomic<bool> hasInbox_{};
+
+    std::atomic<std::size_t> thief_{ noThief };
+    std::atomic<std::uint64_t> load_{};
+
+public:
+    // owned by the worker of the queue
+    std::vector<Task*> tasks_;
+
+    std::uint64_t load() const noexcept
+    {
+        return load_.load(std::memory_order_relaxed);
+    }
+
+    void set_load(std::uint64_t load) noexcept
+    {
+        load_.store(load, std::memory_order_relaxed);
+    }
+
+    bool has_inbox() const noexcept
+    {
+        return hasInbox_.load(std::memory_order_relaxed);
+    }
+
+    // owner, moves donated tasks to tasks_
+    void collect_inbox()
+    {
+        if (!hasInbox_.load(std::memory_order_acquire))
+            return;
+
+        std::unique_lock l(inboxMtx_);
+        tasks_.insert(tasks_.end(), inbox_.begin(), inbox_.end());
+        inbox_.clear();
+        hasInbox_.store(false, std::memory_order_relaxed);
+    }
+
+    // any worker, returns false if another worker asked first
+    bool request_steal(std::size_t thiefIdx) noexcept
+    {
+        std::size_t expected = noThief;
+        return thief_.compare_exchange_strong(expected, thiefIdx, std::memory_order_relaxed);
+    }
+
+    // owner, returns noThief if nobody asked
+    std::size_t take_steal_request() noexcept
+    {
+        if (thief_.load(std::memory_order_relaxed) == noThief) [[likely]]
+            return noThief;
+        return thief_.exchange(noThief, std::memory_order_relaxed);
+    }
+
+    // owner, weight(task) is the recent weight of the task
+    // always keeps one task, returns the donated weight
+    template <typename WeightFn> std::uint64_t donate_to(RunQueue& thief, WeightFn&& weight)
+    {
+        std::uint64_t load = this->load();
+        std::uint64_t thiefLoad = thief.load();
+        if (load <= thiefLoad)
+            return 0;
+
+        std::uint64_t targetWeight = (load - thiefLoad) / 2;
+        std::uint64_t donatedWeight = 0;
+
+        std::vector<Task*> donated;
+        // kept tasks are moved down in order
+        std::size_t numKept = 0;
+        for (std::size_t idx = 0; idx < tasks_.size(); idx++)
+        {
+            Task* task = tasks_[idx];
+            if (tasks_.size() - donated.size() > 1 && donatedWeight < targetWeight)
+            {
+                std::uint64_t taskWeight = weight(*task);
+                // a task heavier than what is left to donate would only move
+                // the imbalance to the thief
+                if (donatedWeight + taskWeight <= targetWeight)
+                {
+                    donated.push_back(task);
+                    donatedWeight += taskWeight;
+                    continue;
+                }
+            }
+            tasks_[numKept++] = task;
+        }
+        tasks_.resize(numKept);
+
+        if (donated.empty())
+            return 0;
+
+        {
+            std::unique_lock l(thief.inboxMtx_);
+            thief.inbox_.insert(thief.inbox_.end(), donated.begin(), donated.end());
+            thief.hasInbox_.store(true, std::memory_order_release);
+        }
+
+        load_.fetch_sub(donatedWeight, std::memory_order_relaxed);
+        thief.load_.fetch_add(donatedWeight, std::memory_order_relaxed);
+        return donatedWeight;
+    }
+};
+} // namespace rvn
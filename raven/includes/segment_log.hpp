@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <msquic.h>
+#include <optional>
+#include <shared_mutex>
+#include <shared_quic_buffer.hpp>
+#include <strong_types.hpp>
+#include <vector>
+
+namespace rvn
+{
+struct SegmentLogOptions
+{
+    // a new segment is started once the active one holds this many groups
+    std::uint64_t groupsPerSegment_ = 64;
+    // size of the mapping reserved per segment, bounds the size of a segment
+    std::uint64_t maxSegmentBytes_ = 1ull << 28;
+    // once exceeded the oldest segments and their groups are deleted, the
+    // log keeps everything if not set
+    std::optional<std::uint64_t> maxSegments_;
+};
+
+/*
+    Append only on disk log of a single track
+
+    Objects are packed into segment files (<sequence>.seg) in the track
+    directory instead of one file per object. Segments are memory mapped,
+    appending is a memcpy into the mapping and the file is grown in
+    doubling steps. A sorted (group id, object id) -> record index is kept in
+    memory and rebuilt by scanning the segments when the log is reopened, a
+    torn record at the tail of the last segment is discarded.
+
+    Record layout (8 byte aligned):
+        RecordHeader | payload (length_ bytes) | padding
+
+    Only the active segment is mapped writable with the full
+    maxSegmentBytes_ reserved, sealed segments are mapped read-only up to
+    their size. Segments beyond maxSegments_ are unlinked and dropped from
+    the index when the log rolls, their mapping is kept until no payload
+    borrowed from them is referenced anymore.
+
+    Readers never copy, the returned payloads point into the mappings.
+    Appends must be serialized by the caller, readers may run concurrently.
+*/
+class SegmentLog
+{
+public:
+    enum class RecordKind : std::uint8_t
+    {
+        Payload,
+        GroupTerminator,
+        TrackTerminator
+    };
+
+    struct Record
+    {
+        GroupId groupId_;
+        ObjectId objectId_;
+        RecordKind kind_;
+        // empty unless kind_ == Payload, borrowed from the log
+        SharedQuicBuffer payload_;
+    };
+
+private:
+    struct RecordHeader
+    {
+        std::uint32_t magic_;
+        std::uint32_t length_;
+        std::uint64_t groupId_;
+        std::uint64_t objectId_;
+        std::uint8_t kind_;
+        std::uint8_t reserved_[7];
+    };
+    static_assert(sizeof(RecordHeader) == 32);
+
+    static constexpr std::uint32_t recordMagic = 0x4e564152; // "RAVN"
+
+    struct Segment
+    {
+        std::uint64_t sequence_;
+        // -1 once the segment is sealed
+        int fd_ = -1;
+        std::uint8_t* data_ = nullptr;
+        std::uint64_t mappedBytes_ = 0;
+        std::uint64_t fileSize_ = 0;
+        std::uint64_t writeOffset_ = 0;
+        std::uint64_t numGroups_ = 0;
+        std::optional<GroupId> lastGroupId_;
+        // records_ of the segment are [firstRecordIdx_, firstRecordIdx_ + numRecords_)
+        std::uint64_t firstRecordIdx_ = 0;
+        std::uint64_t numRecords_ = 0;
+        // unlinked and no longer indexed, unmapped once not borrowed
+        bool dropped_ = false;
+    };
+
+    struct IndexEntry
+    {
+        GroupId groupId_;
+        ObjectId objectId_;
+        std::uint64_t recordIdx_;
+    };
+
+    struct ColdRecord
+    {
+        // points into the mapping, the count drops back to borrowedRefCount
+        // once nobody borrows the payload
+        SharedQuicBuffer::Block payload_;
+        RecordKind kind_;
+
+        ColdRecord(QUIC_BUFFER payload, RecordKind kind)
+        : payload_(payload, SharedQuicBuffer::borrowedRefCount), kind_(kind)
+        {
+        }
+    };
+
+    const std::filesystem::path directory_;
+    const SegmentLogOptions options_;
+
+    // only touched by the writer
+    std::deque<Segment> segments_;
+
+    // writer takes it exclusively to modify, readers shared
+    mutable std::shared_mutex mtx_;
+    // sorted by (group id, object id)
+    std::vector<IndexEntry> index_;
+    // indexed by IndexEntry::recordIdx_ - recordsOffset_, deque keeps the
+    // blocks stable, mutable as borrowing counts references
+    mutable std::deque<ColdRecord> records_;
+    std::uint64_t recordsOffset_ = 0;
+
+    void open_segment(std::uint64_t sequence, bool isActive);
+    void seal_active_segment();
+    void roll_segment();
+    // drops the oldest segments beyond maxSegments_
+    void enforce_max_segments();
+    // unmaps dropped segments which are no longer borrowed from
+    void release_dropped_segments();
+    // scans a mapped segment and indexes its valid records
+    void index_segment(Segment& segment);
+    void index_record(GroupId groupId, ObjectId objectId, RecordKind kind, QUIC_BUFFER payload);
+
+    std::vector<IndexEntry>::const_iterator find(GroupId groupId, ObjectId objectId) const;
+    Record make_record(const IndexEntry& entry) const;
+
+public:
+    // creates the directory if needed and indexes the existing segments
+    SegmentLog(std::filesystem::path directory, SegmentLogOptions options = {});
+
+    SegmentLog(const SegmentLog&) = delete;
+    SegmentLog& operator=(const SegmentLog&) = delete;
+
+    ~SegmentLog();
+
+    // returns false if (groupId, objectId) is already in the log
+    // payload must be set iff kind == Payload
+    bool append(GroupId groupId, ObjectId objectId, RecordKind kind, const QUIC_BUFFER* payload);
+
+    std::optional<Record> first() const;
+    // first record strictly after (groupId, objectId)
+    std::optional<Record> next(GroupId groupId, ObjectId objectId) const;
+    // first record at or after (groupId, objectId)
+    std::optional<Record> lower_bound(GroupId groupId, ObjectId objectId) const;
+    std::optional<GroupId> latest_group_id() const;
+    std::vector<Record> group_records(GroupId groupId) const;
+
+    std::uint64_t size() const;
+};
+} // namespace rvn
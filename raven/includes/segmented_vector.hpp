@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace rvn
+{
+/*
+    Owning storage with stable addresses for objects which are referenced by
+    pointer and scanned in bulk, subscriptions point back to their state and
+    move between threads by handing the pointer over.
+
+    Objects live in fixed size segments which are never moved or freed
+    before the container. Erased slots are reused (lowest address of a new
+    segment first) before another segment is allocated, so live objects stay
+    packed in a few segments instead of being spread over the heap like
+    list nodes.
+
+    emplace and erase may be called from any thread, the objects themselves
+    are not synchronized. Objects still alive are destroyed with the
+    container.
+*/
+template <typename T, std::size_t SegmentSize = 256> class SegmentedVector
+{
+    struct Slot
+    {
+        // first member, a T* is the address of its slot
+        alignas(T) std::byte storage_[sizeof(T)];
+        bool live_ = false;
+    };
+    using Segment = std::array<Slot, SegmentSize>;
+
+    std::mutex mtx_;
+    std::vector<std::unique_ptr<Segment>> segments_;
+    // erased or never used slots, taken from the back
+    std::vector<Slot*> freeSlots_;
+
+    // must hold mtx_
+    void add_segment()
+    {
+        Segment& segment = *segments_.emplace_back(std::make_unique<Segment>());
+        for (auto iter = segment.rbegin(); iter != segment.rend(); ++iter)
+            freeSlots_.push_back(&*iter);
+    }
+
+public:
+    SegmentedVector() = default;
+    SegmentedVector(const SegmentedVector&) = delete;
+    SegmentedVector& operator=(const SegmentedVector&) = delete;
+
+    ~SegmentedVector()
+    {
+        for (auto& segment : segments_)
+            for (auto& slot : *segment)
+                if (slot.live_)
+                    std::launder(reinterpret_cast<T*>(slot.storage_))->~T();
+    }
+
+    template <typename... Args> T* emplace(Args&&... args)
+    {
+        Slot* slot;
+        {
+            std::unique_lock l(mtx_);
+            if (freeSlots_.empty())
+                add_segment();
+            slot = freeSlots_.back();
+            freeSlots_.pop_back();
+        }
+
+        T* object;
+        try
+        {
+            object = new (slot->storage_) T(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            std::unique_lock l(mtx_);
+            freeSlots_.push_back(slot);
+            throw;
+        }
+        slot->live_ = true;
+        return object;
+    }
+
+    void erase(T* object) noexcept
+    {
+        Slot* slot = reinterpret_cast<Slot*>(object);
+        object->~T();
+        slot->live_ = false;
+
+        std::unique_lock l(mtx_);
+        freeSlots_.push_back(slot);
+    }
+};
+} // namespace rvn
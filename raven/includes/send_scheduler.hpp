@@ -0,0 +1,131 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <data_manager.hpp>
+#include <deque>
+#include <limits>
+#include <map>
+#include <optional>
+#include <serialization/messages.hpp>
+#include <shared_quic_buffer.hpp>
+#include <strong_types.hpp>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace rvn
+{
+struct ScheduledObject
+{
+    ObjectIdentifier objectIdentifier_;
+    SharedQuicBuffer payload_;
+    SubscriberPriority subscriberPriority_;
+    PublisherPriority publisherPriority_;
+    GroupOrder groupOrder_;
+    std::optional<std::chrono::milliseconds> timeoutDuration_;
+    // no payload, the stream of the group is finished once the objects
+    // scheduled before it are sent, see end_of_group
+    bool endOfGroup_ = false;
+    // sent as an OBJECT_DATAGRAM instead of on the stream of its group
+    bool datagram_ = false;
+
+    // queued behind every object of the group
+    static ScheduledObject end_of_group(GroupIdentifier groupIdentifier,
+                                        SubscriberPriority subscriberPriority,
+                                        PublisherPriority publisherPriority,
+                                        GroupOrder groupOrder,
+                                        bool datagram = false)
+    {
+        return ScheduledObject{ ObjectIdentifier(std::move(groupIdentifier),
+                                                 ObjectId(std::numeric_limits<std::uint64_t>::max())),
+                                SharedQuicBuffer{},
+                                subscriberPriority,
+                                publisherPriority,
+                                groupOrder,
+                                std::nullopt,
+                                true,
+                                datagram };
+    }
+};
+
+/*
+    Decides which object a connection sends next
+
+    Objects are queued per flow, the objects of one track subscribed with
+    one subscriber priority. Flows are ranked by subscriber priority, then
+    publisher priority (lower is more important for both), flows of the
+    same rank take turns object by object so that none of them starves.
+    Inside a flow objects go out in the group order of the subscription,
+    oldest group first (Ascending) or newest group first (Descending),
+    objects of a group always in order.
+
+    Not thread safe, owned by ConnectionState which serializes access.
+*/
+class SendScheduler
+{
+    struct FlowKey
+    {
+        std::uint64_t trackId_;
+        std::uint8_t subscriberPriority_;
+
+        bool operator==(const FlowKey&) const = default;
+    };
+
+    struct FlowKeyHash
+    {
+        std::size_t operator()(const FlowKey& key) const noexcept
+        {
+            return std::hash<std::uint64_t>{}(key.trackId_ << 8 | key.subscriberPriority_);
+        }
+    };
+
+    struct Flow
+    {
+        GroupOrder groupOrder_;
+        std::map<std::tuple<GroupId, ObjectId>, ScheduledObject> objects_;
+    };
+
+    // (subscriber priority << 8 | publisher priority) -> flows in turn order
+    std::map<std::uint16_t, std::deque<FlowKey>> ranks_;
+    std::unordered_map<FlowKey, Flow, FlowKeyHash> flows_;
+    std::uint64_t size_ = 0;
+    // summed payload length of the queued objects
+    std::uint64_t numBytes_ = 0;
+
+    static std::uint64_t payload_length(const ScheduledObject& scheduledObject) noexcept
+    {
+        return scheduledObject.payload_ ? scheduledObject.payload_->Length : 0;
+    }
+
+public:
+    // supersede drops the queued objects of the same group of the flow,
+    // used by subscriptions which only want the latest object of a group
+    void push(ScheduledObject scheduledObject, bool supersede = false);
+
+    // the most important object, scheduler must not be empty
+    ScheduledObject pop();
+
+    // appends the most important object and the objects following it in
+    // the same group of the same flow to run, at least one object and at
+    // most maxObjects, further objects only while the run stays within
+    // maxBytes and is sent the same way (stream or datagram) as the first
+    // one. Scheduler must not be empty
+    void pop_run(std::vector<ScheduledObject>& run, std::size_t maxObjects, std::uint64_t maxBytes);
+
+    bool empty() const noexcept
+    {
+        return size_ == 0;
+    }
+
+    std::uint64_t size() const noexcept
+    {
+        return size_;
+    }
+
+    std::uint64_t num_bytes() const noexcept
+    {
+        return numBytes_;
+    }
+};
+} // namespace rvn
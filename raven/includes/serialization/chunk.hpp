@@ -261,4 +261,45 @@ public:
         return os;
     }
 };
+
+// span over bytes no chunk owns, e.g. a datagram msquic received
+class ByteSpan
+{
+    const std::uint8_t* data_;
+    std::uint64_t size_;
+
+public:
+    ByteSpan(const std::uint8_t* data, std::uint64_t size) : data_(data), size_(size)
+    {
+    }
+
+    void copy_to(void* dest, std::uint64_t size) const
+    {
+        utils::ASSERT_LOG_THROW(size <= this->size(),
+                                "size must be less than or equal to span size");
+        std::memcpy(dest, data(), size);
+    }
+
+    const std::uint8_t* data() const noexcept
+    {
+        return data_;
+    }
+
+    std::uint64_t size() const noexcept
+    {
+        return size_;
+    }
+
+    std::uint8_t operator[](std::uint64_t index) const noexcept
+    {
+        return data_[index];
+    }
+
+    void advance_begin(std::uint64_t size)
+    {
+        utils::ASSERT_LOG_THROW(size <= size_, "advanced past the end of the span");
+        data_ += size;
+        size_ -= size;
+    }
+};
 } // namespace rvn::ds
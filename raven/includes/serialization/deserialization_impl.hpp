@@ -143,9 +143,11 @@ deserialize_params(std::vector<Parameter>& parameters, ConstSpan& span, NetworkE
 
     std::uint64_t numParameters;
     deserializedBytes += deserialize<ds::quic_var_int>(numParameters, span);
-    parameters.resize(numParameters);
-    for (auto& parameter : parameters)
+    parameters.clear();
+    parameters.reserve(numParameters);
+    for (std::uint64_t i = 0; i < numParameters; i++)
     {
+        Parameter parameter;
         std::uint64_t parameterType;
         deserializedBytes += deserialize<ds::quic_var_int>(parameterType, span);
 
@@ -163,9 +165,25 @@ deserialize_params(std::vector<Parameter>& parameters, ConstSpan& span, NetworkE
                 parameter.parameter_ = deliveryTimeoutParameter;
                 break;
             }
+            case ParameterType::ObjectDelivery:
+            {
+                std::uint64_t delivery;
+                deserializedBytes += deserialize<ds::quic_var_int>(delivery, span);
+                // sent by the peer, an unknown delivery is ignored and the
+                // objects go on streams
+                if (delivery > utils::to_underlying(ObjectDelivery::Datagram))
+                {
+                    LOGE("Ignoring unknown object delivery: ", delivery);
+                    continue;
+                }
+                parameter.parameter_ =
+                ObjectDeliveryParameter{ static_cast<ObjectDelivery>(delivery) };
+                break;
+            }
             default:
                 utils::ASSERT_LOG_THROW(false, "Unknown parameter type: ", parameterType);
         }
+        parameters.push_back(std::move(parameter));
     }
 
     return deserializedBytes;
@@ -348,4 +366,71 @@ deserialize(rvn::SubscribeErrorMessage& subscribeErrorMessage, ConstSpan& span,
     return deserializedBytes;
 }
 
+// length of the quic_var_int leading span, 0 if it is cut short
+template <typename ConstSpan>
+static inline std::uint64_t quic_var_int_length(const ConstSpan& span) noexcept
+{
+    if (span.size() == 0)
+        return 0;
+
+    std::uint64_t length = std::uint64_t(1) << (span[0] >> 6);
+    return span.size() < length ? 0 : length;
+}
+
+/*
+    OBJECT_DATAGRAM Message {
+      Type (i) = 0x1,
+      Track Alias (i),
+      Group ID (i),
+      Object ID (i),
+      Publisher Priority (8),
+      Object Payload Length (i),
+      Object Payload (..),
+    }
+    Reads a whole datagram in place, type included. Datagrams come straight
+    from the peer, so unlike the other messages a wrong type or a truncated
+    message is not asserted on, 0 is returned and span is left part way
+*/
+template <typename ConstSpan>
+static inline deserialize_return_t
+deserialize(rvn::ObjectDatagramMessage& objectDatagramMessage, ConstSpan& span, NetworkEndian = network_endian)
+{
+    std::uint64_t deserializedBytes = 0;
+
+    auto read_quic_var_int = [&](std::uint64_t& value)
+    {
+        if (quic_var_int_length(span) == 0)
+            return false;
+        deserializedBytes += deserialize<ds::quic_var_int>(value, span);
+        return true;
+    };
+
+    std::uint64_t type;
+    if (!read_quic_var_int(type) ||
+        type != static_cast<std::uint64_t>(DataStreamType::OBJECT_DATAGRAM))
+        return 0;
+
+    std::uint64_t trackAlias, groupId, objectId;
+    if (!read_quic_var_int(trackAlias) || !read_quic_var_int(groupId) ||
+        !read_quic_var_int(objectId) || span.size() == 0)
+        return 0;
+
+    std::uint8_t publisherPriority;
+    deserializedBytes += deserialize_trivial<std::uint8_t>(publisherPriority, span);
+
+    std::uint64_t payloadLength;
+    if (!read_quic_var_int(payloadLength) || span.size() < payloadLength)
+        return 0;
+
+    objectDatagramMessage.header_ = ObjectDatagramHeader{ TrackAlias(trackAlias),
+                                                          GroupId(groupId), ObjectId(objectId),
+                                                          PublisherPriority(publisherPriority) };
+    objectDatagramMessage.payload_.resize(payloadLength);
+    span.copy_to(objectDatagramMessage.payload_.data(), payloadLength);
+    span.advance_begin(payloadLength);
+    deserializedBytes += payloadLength;
+
+    return deserializedBytes;
+}
+
 } // namespace rvn::serialization::detail
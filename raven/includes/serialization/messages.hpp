@@ -58,6 +58,8 @@ struct ControlMessageHeader
 enum class ParameterType : std::uint64_t
 {
     DeliveryTimeout = 0x03,
+    // not in draft v7
+    ObjectDelivery = 0x20,
 };
 
 // Only one parameter of each type should be sent
@@ -76,7 +78,31 @@ struct DeliveryTimeoutParameter
     }
 };
 
-using ParameterImpl = std::variant<DeliveryTimeoutParameter>;
+enum class ObjectDelivery : std::uint8_t
+{
+    // objects of a group on one data stream, in order and reliably
+    Stream = 0x0,
+    // every object in an OBJECT_DATAGRAM of its own, neither ordered nor
+    // retransmitted, objects which do not fit a datagram go on a stream
+    Datagram = 0x1
+};
+
+// subscribe parameter, objects go on streams if it is not sent
+struct ObjectDeliveryParameter
+{
+    ObjectDelivery delivery_;
+
+    bool operator==(const ObjectDeliveryParameter&) const = default;
+
+    friend inline std::ostream&
+    operator<<(std::ostream& os, const ObjectDeliveryParameter& param)
+    {
+        os << "ObjectDelivery: " << static_cast<std::uint64_t>(param.delivery_);
+        return os;
+    }
+};
+
+using ParameterImpl = std::variant<DeliveryTimeoutParameter, ObjectDeliveryParameter>;
 struct Parameter
 {
     ParameterImpl parameter_;
@@ -212,6 +238,13 @@ enum class SubscribeFilterType : std::uint64_t
     // sent. If the current send is in progress, it will be aborted
 };
 
+enum class GroupOrder : std::uint8_t
+{
+    Publisher = 0x0, // Use the group order preferred by the publisher
+    Ascending = 0x1, // Oldest group first
+    Descending = 0x2 // Newest group first
+};
+
 struct GroupObjectPair
 {
     GroupId group_;
@@ -487,28 +520,6 @@ struct ObjectStreamMessage
     BinaryBufferData objectPayload;
 };
 
-/*
-    OBJECT_DATAGRAM Message {
-      Subscribe ID (i),
-      Track Alias (i),
-      Group ID (i),
-      Object ID (i),
-      Publisher Priority (8),
-      Object Status (i),
-      Object Payload (..),
-    }
-*/
-struct ObjectDatagramMessage
-{
-    iType subscribeId;
-    iType trackAlias;
-    iType group;
-    iType object;
-    std::uint8_t publisherPriority;
-    ObjectStatus objectStatus;
-    BinaryBufferData objectPayload;
-};
-
 /*
     STREAM_HEADER_TRACK Message {
       Subscribe ID (i)
@@ -715,6 +726,57 @@ struct StreamHeaderSubgroupMessage
     }
 };
 
+/*
+    OBJECT_DATAGRAM Message {
+      Track Alias (i),
+      Group ID (i),
+      Object ID (i),
+      Publisher Priority (8),
+      Object Payload Length (i),
+      Object Payload (..),
+    }
+
+    The header is everything up to the payload length, objects are stored
+    serialized as StreamHeaderSubgroupObject and the payload length and
+    payload following their object id are sent as they are
+*/
+struct ObjectDatagramHeader
+{
+    static constexpr auto id_ = DataStreamType::OBJECT_DATAGRAM;
+    // type, three 8 byte quic_var_ints and the priority
+    static constexpr std::size_t maxSerializedLength = 1 + 3 * 8 + 1;
+
+    TrackAlias trackAlias_;
+    GroupId groupId_;
+    ObjectId objectId_;
+    PublisherPriority publisherPriority_;
+
+    bool operator==(const ObjectDatagramHeader& rhs) const = default;
+
+    inline friend std::ostream& operator<<(std::ostream& os, const ObjectDatagramHeader& msg)
+    {
+        os << "TrackAlias: " << msg.trackAlias_ << " GroupId: " << msg.groupId_
+           << " ObjectId: " << msg.objectId_
+           << " PublisherPriority: " << msg.publisherPriority_;
+        return os;
+    }
+};
+
+struct ObjectDatagramMessage
+{
+    ObjectDatagramHeader header_;
+    std::string payload_;
+
+    bool operator==(const ObjectDatagramMessage& rhs) const = default;
+
+    inline friend std::ostream& operator<<(std::ostream& os, const ObjectDatagramMessage& msg)
+    {
+        os << msg.header_ << " PayloadLength: " << msg.payload_.size()
+           << " Payload: " << msg.payload_;
+        return os;
+    }
+};
+
 // Object type sent on StreamHeaderSubgroup data streams
 struct StreamHeaderSubgroupObject
 {
@@ -4,6 +4,7 @@
 #include <serialization/endianness.hpp>
 #include <serialization/messages.hpp>
 #include <serialization/quic_var_int.hpp>
+#include <span>
 
 namespace rvn::serialization::detail
 {
@@ -131,8 +132,10 @@ template <UnsignedInteger T>
 ///////////////////////////////////////////////////////////////////////////////////////////////
 // Parameter Serialization
 [[nodiscard]]  serialize_return_t mock_serialize(const rvn::DeliveryTimeoutParameter& parameter);
+[[nodiscard]]  serialize_return_t mock_serialize(const rvn::ObjectDeliveryParameter& parameter);
 [[nodiscard]]  serialize_return_t mock_serialize(const rvn::Parameter& parameter);
  serialize_return_t serialize(ds::chunk& c, const rvn::DeliveryTimeoutParameter& parameter);
+ serialize_return_t serialize(ds::chunk& c, const rvn::ObjectDeliveryParameter& parameter);
  serialize_return_t serialize(ds::chunk& c, const rvn::Parameter& parameter);
 ///////////////////////////////////////////////////////////////////////////////////////////////
 // Message serialization
@@ -141,6 +144,10 @@ template <UnsignedInteger T>
  serialize_return_t serialize(ds::chunk& c, const rvn::SubscribeMessage& subscribeMessage);
  serialize_return_t serialize(ds::chunk& c, const StreamHeaderSubgroupMessage& msg);
  serialize_return_t serialize(ds::chunk& c, const StreamHeaderSubgroupObject& msg);
+ serialize_return_t serialize(ds::chunk& c, const ObjectDatagramHeader& msg);
+ // into a buffer of the caller, sending a datagram allocates nothing
+ serialize_return_t serialize(std::span<std::uint8_t, ObjectDatagramHeader::maxSerializedLength> bytes, const ObjectDatagramHeader& msg);
+ serialize_return_t serialize(ds::chunk& c, const ObjectDatagramMessage& msg);
  serialize_return_t serialize(ds::chunk& c, const rvn::SubscribeErrorMessage& subscribeErrorMessage);
  serialize_return_t serialize(ds::chunk& c, const rvn::BatchSubscribeMessage& batchSubscribeMessage);
 ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <msquic.h>
+#include <new>
+#include <utility>
+
+namespace rvn
+{
+/*
+    Reference counted QUIC_BUFFER, used to send object payloads zero copy
+
+    The same buffer is passed to StreamSend of every subscriber. Each send
+    holds a reference until SEND_COMPLETE and the store holds one until the
+    object is evicted, the bytes are freed once the last reference is dropped.
+
+    The count lives right after the QUIC_BUFFER, adopting a serialized
+    QUIC_BUFFER grows its allocation in place instead of allocating a block.
+*/
+class SharedQuicBuffer
+{
+public:
+    struct Block
+    {
+        QUIC_BUFFER quicBuffer_;
+        std::atomic<std::uint64_t> refCount_;
+
+        Block(QUIC_BUFFER quicBuffer, std::uint64_t refCount) noexcept
+        : quicBuffer_(quicBuffer), refCount_(refCount)
+        {
+        }
+    };
+
+    // borrowed blocks start here and never drop to 0
+    static constexpr std::uint64_t borrowedRefCount = 1ull << 62;
+
+private:
+    Block* block_{};
+
+    explicit SharedQuicBuffer(Block* block) noexcept : block_(block)
+    {
+    }
+
+    void retain() const noexcept
+    {
+        if (block_ != nullptr)
+            block_->refCount_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+public:
+    SharedQuicBuffer() = default;
+
+    // takes ownership of a malloced QUIC_BUFFER with malloced bytes
+    // (serialization::serialize)
+    static SharedQuicBuffer adopt(QUIC_BUFFER* quicBuffer)
+    {
+        QUIC_BUFFER value = *quicBuffer;
+        // the QUIC_BUFFER allocation usually has room for the count already
+        void* memory = realloc(quicBuffer, sizeof(Block));
+        if (memory == nullptr)
+            throw std::bad_alloc();
+        return SharedQuicBuffer(new (memory) Block(value, 1));
+    }
+
+    // memory of the block is owned elsewhere and must outlive every reference
+    static SharedQuicBuffer borrow(Block& block) noexcept
+    {
+        SharedQuicBuffer sharedQuicBuffer(&block);
+        sharedQuicBuffer.retain();
+        return sharedQuicBuffer;
+    }
+
+    SharedQuicBuffer(const SharedQuicBuffer& other) noexcept : block_(other.block_)
+    {
+        retain();
+    }
+
+    SharedQuicBuffer(SharedQuicBuffer&& other) noexcept
+    : block_(std::exchange(other.block_, nullptr))
+    {
+    }
+
+    SharedQuicBuffer& operator=(SharedQuicBuffer other) noexcept
+    {
+        std::swap(block_, other.block_);
+        return *this;
+    }
+
+    ~SharedQuicBuffer()
+    {
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        Block* block = std::exchange(block_, nullptr);
+        if (block == nullptr || block->refCount_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+
+        std::uint8_t* bytes = block->quicBuffer_.Buffer;
+        block->~Block();
+        free(bytes);
+        free(block);
+    }
+
+    // msquic takes non const buffers, it never writes to them
+    QUIC_BUFFER* get() const noexcept
+    {
+        return block_ != nullptr ? &block_->quicBuffer_ : nullptr;
+    }
+
+    QUIC_BUFFER* operator->() const noexcept
+    {
+        return get();
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return block_ != nullptr;
+    }
+};
+} // namespace rvn
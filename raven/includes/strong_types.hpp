@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
 namespace rvn
 {
@@ -158,6 +159,7 @@ struct ObjectIdTag{};
 struct GroupIdTag{};
 struct SubGroupIdTag{};
 struct TrackAliasTag{};
+struct TrackIdTag{};
 struct SubscriberPriorityTag{};
 struct PublisherPriorityTag{};
 
@@ -165,6 +167,8 @@ using ObjectId = detail::StrongTypeImpl<std::uint64_t, ObjectIdTag, detail::Uint
 using GroupId = detail::StrongTypeImpl<std::uint64_t, GroupIdTag, detail::UintCTRPTrait>;
 using SubGroupId = detail::StrongTypeImpl<std::uint64_t, SubGroupIdTag, detail::UintCTRPTrait>;
 using TrackAlias = detail::StrongTypeImpl<std::uint64_t, TrackAliasTag, detail::UintCTRPTrait>;
+// process local dense id of an interned TrackIdentifier, never sent on the wire
+using TrackId = detail::StrongTypeImpl<std::uint64_t, TrackIdTag, detail::UintCTRPTrait>;
 
 // MOQT priority values are 8 bit integers where as MsQuic supports 16 bit integers, be very careful when converting MsQuic priority to MOQT priority
 // Low priority value means more important according to MOQT and MsQuic (ig so, https://github.com/microsoft/msquic/issues/4826)
@@ -172,4 +176,13 @@ using SubscriberPriority = detail::StrongTypeImpl<std::uint8_t, SubscriberPriori
 using PublisherPriority = detail::StrongTypeImpl<std::uint8_t, PublisherPriorityTag, detail::UintCTRPTrait>;
 // clang-format on
 
+// hasher of unordered containers keyed by a strong type
+struct StrongTypeHash
+{
+    template <typename StrongType> std::size_t operator()(const StrongType& value) const noexcept
+    {
+        return value.hash();
+    }
+};
+
 }; // namespace rvn
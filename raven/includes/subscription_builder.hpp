@@ -165,6 +165,16 @@ public:
         return *this;
     }
 
+    // optional, objects go on streams unless set
+    SubscriptionBuilder& set_object_delivery(ObjectDelivery objectDelivery)
+    {
+        std::erase_if(subscribeMessage_.parameters_,
+                      [](const Parameter& parameter)
+                      { return std::holds_alternative<ObjectDeliveryParameter>(parameter.parameter_); });
+        subscribeMessage_.parameters_.push_back(Parameter{ ObjectDeliveryParameter{ objectDelivery } });
+        return *this;
+    }
+
     SubscribeMessage build()
     {
         utils::ASSERT_LOG_THROW(setElementsCounter_ == all_elements_set(),
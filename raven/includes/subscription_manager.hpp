@@ -3,11 +3,17 @@
 #include <chrono>
 #include <data_manager.hpp>
 #include <definitions.hpp>
+#include <deque>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <optional>
+#include <run_queue.hpp>
+#include <segmented_vector.hpp>
 #include <serialization/messages.hpp>
 #include <serialization/serialization.hpp>
 #include <strong_types.hpp>
+#include <unordered_map>
 #include <utilities.hpp>
 
 namespace rvn
@@ -26,11 +32,95 @@ struct SubscriptionStateErr
 // bool is false => continue to next object
 using FulfillSomeReturn = std::variant<bool, SubscriptionStateErr::ConnectionExpired>;
 
+// connection which had objects scheduled in the round of a subscription
+// thread, connectionState_ is only dereferenced under an EpochDomain::Guard
+// while connectionStateWeakPtr_ has not expired
+struct ConnectionToFlush
+{
+    ConnectionState* connectionState_;
+    std::weak_ptr<ConnectionState> connectionStateWeakPtr_;
+};
+
+// flushed at the end of the round, connections out of send budget are
+// kept until their scheduled objects are sent
+using ConnectionsToFlush = std::vector<ConnectionToFlush>;
+
 enum class NextOperation
 {
     First,
     Next,
-    Latest
+    Latest,
+    // first object at or after startObject_
+    Seek,
+    // like Latest, a newer object of the group being sent preempts it
+    LatestPerGroup
+};
+
+/*
+    Track lookups done by a subscription thread in one round, keyed by track,
+    operation and the position of the subscriber
+
+    Subscribers of a track at the same position (live viewers) share a single
+    lookup and are handed the same payload buffer. Cleared after every round,
+    published objects never change so entries stay valid for the round and a
+    cached WaitSignal is at worst set earlier than a fresh one.
+
+    Not a fan-out engine, subscriptions are not grouped by track. Each one
+    still runs its own fulfill_some and hits the cache, and subscribers of a
+    track spread over N threads cost N lookups per object
+    (tests/perf/track_fanout.cpp).
+*/
+class FanoutCache
+{
+    struct Key
+    {
+        const TrackHandle* trackHandle_;
+        NextOperation nextOperation_;
+        // max if the subscriber has no position yet
+        std::uint64_t groupId_;
+        std::uint64_t objectId_;
+
+        bool operator==(const Key&) const = default;
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& key) const noexcept
+        {
+            std::size_t seed = std::hash<const TrackHandle*>{}(key.trackHandle_);
+            boost::hash_combine(seed, static_cast<std::uint8_t>(key.nextOperation_));
+            boost::hash_combine(seed, key.groupId_);
+            boost::hash_combine(seed, key.objectId_);
+            return seed;
+        }
+    };
+
+    std::unordered_map<Key, EnrichedObjectOrWait, KeyHash> lookups_;
+
+public:
+    // lookup() is only called on a miss
+    template <typename Lookup>
+    const EnrichedObjectOrWait& get(const TrackHandle& trackHandle,
+                                    NextOperation nextOperation,
+                                    const std::optional<ObjectIdentifier>& position,
+                                    Lookup&& lookup)
+    {
+        constexpr std::uint64_t noPosition = std::numeric_limits<std::uint64_t>::max();
+        Key key{ &trackHandle, nextOperation,
+                 position.has_value() ? position->groupId_.get() : noPosition,
+                 position.has_value() ? position->objectId_.get() : noPosition };
+
+        auto iter = lookups_.find(key);
+        if (iter == lookups_.end())
+            iter = lookups_.emplace(key, lookup()).first;
+        return iter->second;
+    }
+
+    // drops the references on the cached payloads
+    void clear() noexcept
+    {
+        lookups_.clear();
+    }
 };
 
 // TODO: remove concept of minor subscription
@@ -41,27 +131,46 @@ class MinorSubscriptionState
     std::optional<ObjectIdentifier> previouslySentObject_;
 
     NextOperation nextOperation_;
+    // only used by NextOperation::Seek
+    std::optional<ObjectIdentifier> startObject_;
+    // inclusive
     std::optional<ObjectIdentifier> lastObjectToBeSent_;
 
     PublisherPriority trackPublisherPriority_;
+    SubscriberPriority subscriberPriority_;
+    // never GroupOrder::Publisher, resolved on construction
+    GroupOrder groupOrder_;
     bool mustBeSent_;
+    // ObjectDeliveryParameter of the subscription
+    bool datagram_;
     std::optional<WaitSignal> waitSignal_;
+    // the end of the group of previouslySentObject_ has been scheduled
+    bool previousGroupEnded_ = false;
 
     std::optional<std::chrono::milliseconds> subscribeDeliveryTimeout_;
 
+    // the data stream of the group is finished (FIN) once the objects
+    // scheduled before are sent
+    void end_previous_group(ConnectionState& connectionState, ConnectionsToFlush& connectionsToFlush);
+
 public:
+    // bounds the objects sent by one fulfill_some_minor call
+    static constexpr std::uint64_t maxObjectsPerRound = 16;
+
     MinorSubscriptionState(SubscriptionState& subscriptionState,
                            NextOperation nextOperation,
+                           std::optional<ObjectIdentifier> startObject,
                            std::optional<ObjectIdentifier> lastObjectToBeSent,
                            PublisherPriority trackPublisherPriority,
                            std::optional<std::chrono::milliseconds> deliveryTimeout);
 
     // returs true if minor subscription state has been fulfilled
-    FulfillSomeReturn fulfill_some_minor();
+    FulfillSomeReturn
+    fulfill_some_minor(FanoutCache& fanoutCache, ConnectionsToFlush& connectionsToFlush);
 
     // need this function to be inlined (for better performance) as it is called
     // in tight loop
-    inline bool is_waiting_for_object();
+    inline bool is_waiting_for_object() const noexcept;
 
     // TODO: cleanup in destructor, notify client that minor subscription has
     // ended WARNING: adding destructor will disable implicitly generated move
@@ -74,17 +183,31 @@ class SubscriptionState
     friend MinorSubscriptionState;
     // NOTE: should be protected by checking if it actually exists
     std::weak_ptr<ConnectionState> connectionStateWeakPtr_;
+    // ConnectionState::create defers destruction through the EpochDomain,
+    // valid under a guard pinned before connection_expired() returned false
+    ConnectionState* connectionState_;
     // can not be reference because we need Subscription State to be assignable
     // (while removing it from vector)
     DataManager* dataManager_;
     class SubscriptionManager* subscriptionManager_;
     SubscribeMessage subscriptionMessage_;
 
+    // nullptr while the track has not been added by its publisher, the
+    // subscription is parked on trackWaitSignal_ until then
     std::shared_ptr<TrackHandle> trackHandle_;
+    std::optional<WaitSignal> trackWaitSignal_;
     std::vector<MinorSubscriptionState> minorSubscriptionStates_;
 
+    // objects sent recently, halved every load window of the owning thread
+    std::uint64_t recentSends_ = 0;
+
     void error_handler(SubscriptionStateErr::ConnectionExpired);
 
+    // looks up the track and sets up the minor subscriptions, parks on
+    // trackWaitSignal_ if the track is not there yet
+    // returns false if the connection expired or the subscription is invalid
+    bool try_activate();
+
 public:
     bool cleanup_;
     SubscriptionState(std::weak_ptr<ConnectionState>&& connectionState,
@@ -92,7 +215,34 @@ public:
                       SubscriptionManager& subscriptionManager,
                       SubscribeMessage subscriptionMessage);
 
-    FulfillSomeReturn fulfill_some();
+    FulfillSomeReturn fulfill_some(FanoutCache& fanoutCache, ConnectionsToFlush& connectionsToFlush);
+
+    // true if fulfill_some can not make progress until a signal is set
+    bool is_idle() const noexcept;
+
+    // the signal fulfill_some waits on, nullopt if it can make progress
+    // right away or waits on more than one signal
+    std::optional<WaitSignal> wake_signal() const noexcept;
+
+    // weight used to balance subscriptions between threads
+    std::uint64_t load() const noexcept
+    {
+        return 1 + recentSends_;
+    }
+
+    // ages recentSends_, returns the load before aging
+    std::uint64_t take_load() noexcept
+    {
+        std::uint64_t load = this->load();
+        recentSends_ /= 2;
+        return load;
+    }
+
+    // a plain load of the use count, unlike locking the weak_ptr
+    bool connection_expired() const noexcept
+    {
+        return connectionStateWeakPtr_.expired();
+    }
 
     std::weak_ptr<ConnectionState>& get_connection_state_weak_ptr() noexcept
     {
@@ -112,12 +262,74 @@ public:
 struct ThreadLocalState
 {
     SubscriptionManager& subscriptionManager_;
-    // subscription state which this thread is handling
-    // has to be stable container because we have pointers back to subscription
-    // state
-    StableContainer<SubscriptionState> subscriptionStates_;
+    std::size_t threadIdx_;
+    // subscription states which this thread is handling, owned by
+    // SubscriptionManager::subscriptionStates_ as there are pointers back to
+    // them, subscriptions move between threads by handing the pointer over
+    RunQueue<SubscriptionState> runQueue_;
+    FanoutCache fanoutCache_;
+
+    /*
+        Wake signals of the subscriptions of runQueue_, kept as arrays which
+        are scanned every round instead of touching every subscription state,
+        which only happens for subscriptions whose signal is set. Entry i is
+        the subscription runQueue_.tasks_[i]. Rebuilt when subscriptions are
+        added, removed or move between threads, which is rare compared to
+        rounds.
+    */
+    struct WakeSignals
+    {
+        // nullptr if the subscription runs every round
+        std::vector<const EpochNotifier*> notifiers_;
+        std::vector<std::uint32_t> observedEpochs_;
+
+        bool is_ready(std::size_t idx) const noexcept
+        {
+            return notifiers_[idx] == nullptr ||
+                   notifiers_[idx]->epoch(std::memory_order_relaxed) != observedEpochs_[idx];
+        }
+
+        void set(std::size_t idx, const std::optional<WaitSignal>& wakeSignal) noexcept
+        {
+            notifiers_[idx] = wakeSignal.has_value() ? &wakeSignal->notifier() : nullptr;
+            observedEpochs_[idx] = wakeSignal.has_value() ? wakeSignal->observed_epoch() : 0;
+        }
+    };
+    WakeSignals wakeSignals_;
+    bool wakeSignalsStale_ = true;
+    ConnectionsToFlush connectionsToFlush_;
+
+    /*
+        Number of idle rounds spent spinning before parking on
+        DataManager::activityNotifier_. Doubled when work showed up while
+        spinning, halved when the thread had to park.
+    */
+    static constexpr std::uint64_t minSpinRounds = 16;
+    static constexpr std::uint64_t maxSpinRounds = 4096;
+    std::uint64_t spinRounds_ = minSpinRounds;
+
+    // the load of the run queue is recomputed (and subscription loads
+    // halved) every loadWindowRounds rounds
+    static constexpr std::uint64_t loadWindowRounds = 64;
+    // idle threads only steal from threads loaded at least this much more
+    static constexpr std::uint64_t minStealLoad = 8;
+    bool stealRequested_ = false;
+
+    ThreadLocalState(SubscriptionManager& subscriptionManager, std::size_t threadIdx)
+    : subscriptionManager_(subscriptionManager), threadIdx_(threadIdx)
+    {
+    }
 
     void operator()();
+
+private:
+    void rebuild_wake_signals();
+    bool is_idle() const noexcept;
+    void update_load() noexcept;
+    // asks the most loaded thread for subscriptions
+    void request_steal() noexcept;
+    // hands subscriptions to a thread which asked for them
+    void answer_steal_request();
 };
 
 class SubscriptionManager
@@ -129,7 +341,12 @@ class SubscriptionManager
     // holds subscriptions messages which need to be processed and start executing
     MPMCQueue<std::tuple<std::weak_ptr<ConnectionState>, SubscribeMessage>> subscriptionQueue_;
 
-    std::vector<ThreadLocalState> threadLocalStates_;
+    // every subscription state, the run queues of the threads point into it
+    // outlives the threads and their states
+    SegmentedVector<SubscriptionState> subscriptionStates_;
+
+    // deque as states are neither copyable nor movable
+    std::deque<ThreadLocalState> threadLocalStates_;
     // thread pool to manage subscriptions
     std::vector<std::jthread> threadPool_;
 
@@ -0,0 +1,452 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <epoch.hpp>
+#include <new>
+#include <optional>
+#include <strong_types.hpp>
+#include <utilities.hpp>
+#include <utility>
+#include <vector>
+
+namespace rvn
+{
+// customization point for values held in a TrackStore
+template <typename T> struct TrackStoreTraits
+{
+    // bytes accounted against retention limits
+    static std::uint64_t size(const T&) noexcept
+    {
+        return sizeof(T);
+    }
+
+    // called once the group holding the value is evicted and reclaimed
+    static void destroy(T& value) noexcept
+    {
+        value.~T();
+    }
+};
+
+/*
+    Object store of a single track, indexed by group and object id
+
+    Groups are kept sorted by group id and the objects of a group are held in
+    slots indexed by object id. Publishers almost always append to the last
+    group, so the common operations (first, next, latest and append) are O(1)
+    and touch contiguous memory instead of chasing red black tree nodes.
+
+    Readers never take a lock:
+        * object slots live in segments which never move once allocated, a slot
+          is published by a release store after the object is constructed and
+          is immutable afterwards
+        * the sorted group index is copy on write, a new index is published
+          only after its new group holds an object, the old index is retired
+          to the EpochDomain
+    Writers (emplace, evict_oldest_group) must be serialized by the caller.
+
+    Readers copy the value out while pinned, an evicted group is unlinked
+    from the index and destroyed after an epoch grace period. Values which
+    must outlive eviction (payloads being sent) have to own their memory,
+    e.g. by being reference counted.
+
+    Invariants:
+        * the published index never holds an empty group
+        * slots firstObjectId_ and endObjectId_ - 1 of every group are published
+*/
+template <typename T> class TrackStore
+{
+    class Group
+    {
+        struct Slot
+        {
+            std::atomic<bool> published_{};
+            alignas(T) unsigned char storage_[sizeof(T)];
+
+            const T& value() const noexcept
+            {
+                return *std::launder(reinterpret_cast<const T*>(storage_));
+            }
+        };
+
+        /*
+            Segment 0 holds object ids [0, 16), segment k > 0 holds object ids
+            [2^(k + 3), 2^(k + 4)), segments are allocated on first use
+        */
+        static constexpr std::uint64_t firstSegmentBits = 4;
+        static constexpr std::uint64_t numSegments = 32;
+        std::array<std::atomic<Slot*>, numSegments> segments_{};
+
+        static std::uint64_t segment_index(std::uint64_t objectId) noexcept
+        {
+            if (objectId < (1ull << firstSegmentBits))
+                return 0;
+            return std::bit_width(objectId) - firstSegmentBits;
+        }
+
+        static std::uint64_t segment_begin(std::uint64_t segmentIdx) noexcept
+        {
+            return segmentIdx == 0 ? 0 : 1ull << (segmentIdx + firstSegmentBits - 1);
+        }
+
+        static std::uint64_t segment_size(std::uint64_t segmentIdx) noexcept
+        {
+            return segmentIdx == 0 ? 1ull << firstSegmentBits :
+                                     1ull << (segmentIdx + firstSegmentBits - 1);
+        }
+
+        const Slot* slot(std::uint64_t objectId) const noexcept
+        {
+            std::uint64_t segmentIdx = segment_index(objectId);
+            if (segmentIdx >= numSegments)
+                return nullptr;
+
+            const Slot* segment = segments_[segmentIdx].load(std::memory_order_acquire);
+            if (segment == nullptr)
+                return nullptr;
+            return segment + (objectId - segment_begin(segmentIdx));
+        }
+
+    public:
+        const GroupId groupId_;
+        // smallest published object id
+        std::atomic<std::uint64_t> firstObjectId_;
+        // largest published object id + 1
+        std::atomic<std::uint64_t> endObjectId_;
+
+        // writer only
+        const std::chrono::steady_clock::time_point createdAt_;
+        std::uint64_t numObjects_{};
+        std::uint64_t numBytes_{};
+
+        Group(GroupId groupId, ObjectId objectId)
+        : groupId_(groupId), firstObjectId_(objectId), endObjectId_(objectId),
+          createdAt_(std::chrono::steady_clock::now())
+        {
+        }
+
+        ~Group()
+        {
+            for (std::uint64_t segmentIdx = 0; segmentIdx < numSegments; segmentIdx++)
+            {
+                Slot* segment = segments_[segmentIdx].load(std::memory_order_relaxed);
+                if (segment == nullptr)
+                    continue;
+
+                for (std::uint64_t i = 0; i < segment_size(segmentIdx); i++)
+                    if (segment[i].published_.load(std::memory_order_relaxed))
+                        TrackStoreTraits<T>::destroy(
+                        *std::launder(reinterpret_cast<T*>(segment[i].storage_)));
+                delete[] segment;
+            }
+        }
+
+        bool contains(std::uint64_t objectId) const noexcept
+        {
+            const Slot* s = slot(objectId);
+            return s != nullptr && s->published_.load(std::memory_order_acquire);
+        }
+
+        const T& value(std::uint64_t objectId) const noexcept
+        {
+            return slot(objectId)->value();
+        }
+
+        // writer only
+        template <typename... Args> void emplace(std::uint64_t objectId, Args&&... args)
+        {
+            std::uint64_t segmentIdx = segment_index(objectId);
+            utils::ASSERT_LOG_THROW(segmentIdx < numSegments,
+                                    "Object id too large: ", objectId);
+
+            Slot* segment = segments_[segmentIdx].load(std::memory_order_relaxed);
+            if (segment == nullptr)
+            {
+                segment = new Slot[segment_size(segmentIdx)];
+                segments_[segmentIdx].store(segment, std::memory_order_release);
+            }
+
+            Slot& s = segment[objectId - segment_begin(segmentIdx)];
+            T* value = new (s.storage_) T(std::forward<Args>(args)...);
+            numObjects_++;
+            numBytes_ += TrackStoreTraits<T>::size(*value);
+            s.published_.store(true, std::memory_order_release);
+
+            if (objectId < firstObjectId_.load(std::memory_order_relaxed))
+                firstObjectId_.store(objectId, std::memory_order_release);
+            if (objectId >= endObjectId_.load(std::memory_order_relaxed))
+                endObjectId_.store(objectId + 1, std::memory_order_release);
+        }
+
+        // first published object id >= objectId
+        std::optional<std::uint64_t> lower_bound(std::uint64_t objectId) const noexcept
+        {
+            objectId = std::max(objectId, firstObjectId_.load(std::memory_order_acquire));
+            std::uint64_t endObjectId = endObjectId_.load(std::memory_order_acquire);
+
+            while (objectId < endObjectId)
+            {
+                std::uint64_t segmentIdx = segment_index(objectId);
+                const Slot* segment = segments_[segmentIdx].load(std::memory_order_acquire);
+                std::uint64_t segmentEnd =
+                std::min(endObjectId, segment_begin(segmentIdx) + segment_size(segmentIdx));
+
+                if (segment == nullptr)
+                {
+                    objectId = segmentEnd;
+                    continue;
+                }
+
+                for (; objectId < segmentEnd; objectId++)
+                    if (segment[objectId - segment_begin(segmentIdx)].published_.load(
+                        std::memory_order_acquire))
+                        return objectId;
+            }
+            return std::nullopt;
+        }
+    };
+
+    // immutable once published
+    struct GroupIndex
+    {
+        std::vector<Group*> groups_;
+
+        // index of the first group with group id >= groupId
+        std::uint64_t lower_bound(GroupId groupId) const noexcept
+        {
+            if (groups_.empty())
+                return 0;
+
+            // group ids are usually dense, try direct indexing first
+            GroupId frontGroupId = groups_.front()->groupId_;
+            std::uint64_t guess = groupId - frontGroupId;
+            if (groupId >= frontGroupId && guess < groups_.size() &&
+                groups_[guess]->groupId_ == groupId) [[likely]]
+                return guess;
+
+            auto iter = std::lower_bound(groups_.begin(), groups_.end(), groupId,
+                                         [](const Group* group, GroupId groupId)
+                                         { return group->groupId_ < groupId; });
+            return iter - groups_.begin();
+        }
+    };
+
+    std::atomic<GroupIndex*> index_;
+    std::atomic<std::uint64_t> numObjects_{};
+    std::atomic<std::uint64_t> numBytes_{};
+
+    // replaces the published index, old index is reclaimed after a grace period
+    void publish_index(GroupIndex* newIndex)
+    {
+        GroupIndex* oldIndex = index_.exchange(newIndex, std::memory_order_acq_rel);
+        EpochDomainHandle()->retire(oldIndex);
+    }
+
+public:
+    struct Entry
+    {
+        GroupId groupId_;
+        ObjectId objectId_;
+        T value_;
+    };
+
+    struct GroupInfo
+    {
+        GroupId groupId_;
+        std::chrono::steady_clock::time_point createdAt_;
+        std::uint64_t numBytes_;
+    };
+
+private:
+    // must be called with an EpochDomain::Guard held
+    static Entry make_entry(const Group* group, std::uint64_t objectId)
+    {
+        return Entry{ group->groupId_, ObjectId(objectId), group->value(objectId) };
+    }
+
+public:
+
+    TrackStore() : index_(new GroupIndex())
+    {
+    }
+
+    TrackStore(const TrackStore&) = delete;
+    TrackStore& operator=(const TrackStore&) = delete;
+
+    ~TrackStore()
+    {
+        GroupIndex* index = index_.load(std::memory_order_relaxed);
+        for (Group* group : index->groups_)
+            delete group;
+        delete index;
+    }
+
+    std::uint64_t size() const noexcept
+    {
+        return numObjects_.load(std::memory_order_relaxed);
+    }
+
+    // bytes held by groups which have not been evicted
+    std::uint64_t num_bytes() const noexcept
+    {
+        return numBytes_.load(std::memory_order_relaxed);
+    }
+
+    // writer only
+    std::uint64_t num_groups() const noexcept
+    {
+        return index_.load(std::memory_order_relaxed)->groups_.size();
+    }
+
+    // writer only
+    std::optional<GroupInfo> oldest_group() const noexcept
+    {
+        const GroupIndex* index = index_.load(std::memory_order_relaxed);
+        if (index->groups_.empty())
+            return std::nullopt;
+
+        const Group* group = index->groups_.front();
+        return GroupInfo{ group->groupId_, group->createdAt_, group->numBytes_ };
+    }
+
+    // writer only
+    void evict_oldest_group()
+    {
+        const GroupIndex* index = index_.load(std::memory_order_relaxed);
+        if (index->groups_.empty())
+            return;
+
+        Group* group = index->groups_.front();
+
+        GroupIndex* newIndex = new GroupIndex();
+        newIndex->groups_.assign(index->groups_.begin() + 1, index->groups_.end());
+        publish_index(newIndex);
+
+        numObjects_.fetch_sub(group->numObjects_, std::memory_order_relaxed);
+        numBytes_.fetch_sub(group->numBytes_, std::memory_order_relaxed);
+
+        // readers pinned before the unlink may still copy values
+        EpochDomainHandle()->retire(group);
+    }
+
+    bool empty() const noexcept
+    {
+        return size() == 0;
+    }
+
+    // returns false if (groupId, objectId) is already present
+    // NOTE: concurrent calls to emplace must be serialized by the caller
+    template <typename... Args>
+    bool emplace(GroupId groupId, ObjectId objectId, Args&&... args)
+    {
+        GroupIndex* index = index_.load(std::memory_order_relaxed);
+        std::uint64_t groupIdx = index->lower_bound(groupId);
+
+        if (groupIdx != index->groups_.size() &&
+            index->groups_[groupIdx]->groupId_ == groupId) [[likely]]
+        {
+            Group* group = index->groups_[groupIdx];
+            if (group->contains(objectId))
+                return false;
+
+            std::uint64_t numBytesBefore = group->numBytes_;
+            group->emplace(objectId, std::forward<Args>(args)...);
+            numBytes_.fetch_add(group->numBytes_ - numBytesBefore, std::memory_order_relaxed);
+        }
+        else
+        {
+            Group* group = new Group(groupId, objectId);
+            group->emplace(objectId, std::forward<Args>(args)...);
+            numBytes_.fetch_add(group->numBytes_, std::memory_order_relaxed);
+
+            GroupIndex* newIndex = new GroupIndex();
+            newIndex->groups_.reserve(index->groups_.size() + 1);
+            newIndex->groups_ = index->groups_;
+            newIndex->groups_.insert(newIndex->groups_.begin() + groupIdx, group);
+            publish_index(newIndex);
+        }
+
+        numObjects_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    std::optional<Entry> first() const
+    {
+        EpochDomain::Guard guard(*EpochDomainHandle());
+        const GroupIndex* index = index_.load(std::memory_order_acquire);
+
+        if (index->groups_.empty())
+            return std::nullopt;
+
+        const Group* group = index->groups_.front();
+        std::uint64_t objectId = group->firstObjectId_.load(std::memory_order_acquire);
+        return make_entry(group, objectId);
+    }
+
+    // first entry at or after (groupId, objectId)
+    std::optional<Entry> lower_bound(GroupId groupId, ObjectId objectId) const
+    {
+        EpochDomain::Guard guard(*EpochDomainHandle());
+        const GroupIndex* index = index_.load(std::memory_order_acquire);
+
+        std::uint64_t groupIdx = index->lower_bound(groupId);
+        if (groupIdx == index->groups_.size())
+            return std::nullopt;
+
+        const Group* group = index->groups_[groupIdx];
+        if (group->groupId_ == groupId)
+        {
+            auto objectIdAtOrAfter = group->lower_bound(objectId);
+            if (objectIdAtOrAfter.has_value())
+                return make_entry(group, *objectIdAtOrAfter);
+
+            if (++groupIdx == index->groups_.size())
+                return std::nullopt;
+            group = index->groups_[groupIdx];
+        }
+
+        std::uint64_t firstObjectId = group->firstObjectId_.load(std::memory_order_acquire);
+        return make_entry(group, firstObjectId);
+    }
+
+    // first entry strictly after (groupId, objectId)
+    std::optional<Entry> next(GroupId groupId, ObjectId objectId) const
+    {
+        return lower_bound(groupId, ObjectId(objectId + 1));
+    }
+
+    std::optional<Entry> latest() const
+    {
+        EpochDomain::Guard guard(*EpochDomainHandle());
+        const GroupIndex* index = index_.load(std::memory_order_acquire);
+
+        if (index->groups_.empty())
+            return std::nullopt;
+
+        const Group* group = index->groups_.back();
+        std::uint64_t objectId = group->endObjectId_.load(std::memory_order_acquire) - 1;
+        return make_entry(group, objectId);
+    }
+
+    std::optional<Entry> find(GroupId groupId, ObjectId objectId) const
+    {
+        EpochDomain::Guard guard(*EpochDomainHandle());
+        const GroupIndex* index = index_.load(std::memory_order_acquire);
+
+        std::uint64_t groupIdx = index->lower_bound(groupId);
+        if (groupIdx == index->groups_.size() ||
+            index->groups_[groupIdx]->groupId_ != groupId)
+            return std::nullopt;
+
+        const Group* group = index->groups_[groupIdx];
+        if (!group->contains(objectId))
+            return std::nullopt;
+
+        return make_entry(group, objectId);
+    }
+};
+} // namespace rvn
@@ -5,6 +5,7 @@
 ////////////////////////////////////////////
 #include <memory>
 #include <stdexcept>
+#include <utility>
 ////////////////////////////////////////////
 #include <utilities.hpp>
 ////////////////////////////////////////////
@@ -477,6 +478,12 @@ public:
     {
         return streamHandle;
     }
+
+    // gives up ownership without shutting the stream down
+    HQUIC release()
+    {
+        return std::exchange(streamHandle, nullptr);
+    }
 };
 
 class QUIC_BUFFERDeleter
@@ -4,6 +4,7 @@
 #include <contexts.hpp>
 #include <data_manager.hpp>
 #include <definitions.hpp>
+#include <epoch.hpp>
 #include <message_handler.hpp>
 #include <moqt.hpp>
 #include <msquic.h>
@@ -14,36 +15,64 @@
 #include <variant>
 #include <wrappers.hpp>
 ////////////////////////////////
+#include <algorithm>
 #include <memory>
 #include <optional>
 #include <stdexcept>
+#include <tuple>
 ////////////////////////////////
 
 namespace rvn
 {
 
-DataStreamState::DataStreamState(rvn::unique_stream&& stream, struct ConnectionState& connectionState)
-: StreamState(std::move(stream), connectionState),
-  lifeTimeFlag_(std::make_shared<std::monostate>()),
-  objectQueue_(std::make_shared<MPMCQueue<StreamHeaderSubgroupObject>>())
+StreamSendContext::StreamSendContext(Buffers buffers,
+                                     StreamContext* streamContext_,
+                                     std::optional<TimePoint> timeout)
+: buffers_(std::move(buffers)), streamContext(streamContext_), timeout_(timeout)
 {
+    quicBuffers_.reserve(buffers_.size());
+    for (const auto& buffer : buffers_)
+    {
+        quicBuffers_.push_back(*buffer.get());
+        numBytes_ += buffer->Length;
+    }
+
+    streamContext->numPendingSends_.fetch_add(1, std::memory_order_relaxed);
+    streamContext->connectionState_.on_send_started(numBytes_);
 }
 
-bool DataStreamState::can_send_object(const ObjectIdentifier& objectIdentifier) const noexcept
+StreamSendContext::~StreamSendContext()
 {
-    auto trackAliasOpt = connectionState_.identifier_to_alias(objectIdentifier);
-    if (!trackAliasOpt.has_value())
-        return false;
+    destroy_buffers();
+    streamContext->numPendingSends_.fetch_sub(1, std::memory_order_release);
+    streamContext->connectionState_.on_send_completed(numBytes_);
+}
 
-    bool trackBoolMatch =
-    (streamHeaderSubgroupMessage_->groupId_ == objectIdentifier.groupId_) &&
-    (trackAliasOpt.value() == streamHeaderSubgroupMessage_->trackAlias_);
+DatagramSendContext::DatagramSendContext(const HeaderBytes& header,
+                                         std::uint32_t headerLength,
+                                         SharedQuicBuffer object,
+                                         std::uint32_t objectOffset,
+                                         ConnectionState& connectionState)
+: header_(header), object_(std::move(object)), connectionState_(connectionState)
+{
+    quicBuffers_[0] = { headerLength, header_.data() };
+    quicBuffers_[1] = { object_->Length - objectOffset, object_->Buffer + objectOffset };
+    numBytes_ = quicBuffers_[0].Length + quicBuffers_[1].Length;
 
-    if (!trackBoolMatch)
-        return false;
+    connectionState_.on_send_started(numBytes_);
+}
 
-    // TODO: return true should be replaced with subgroupId match
-    return true;
+DatagramSendContext::~DatagramSendContext()
+{
+    object_.reset();
+    connectionState_.on_send_completed(numBytes_);
+}
+
+DataStreamState::DataStreamState(rvn::unique_stream&& stream, struct ConnectionState& connectionState)
+: StreamState(std::move(stream), connectionState),
+  lifeTimeFlag_(std::make_shared<std::monostate>()),
+  objectQueue_(std::make_shared<MPMCQueue<StreamHeaderSubgroupObject>>())
+{
 }
 
 void DataStreamState::set_header(StreamHeaderSubgroupMessage streamHeaderSubgroupMessage)
@@ -57,17 +86,130 @@ std::weak_ptr<void> DataStreamState::get_life_time_flag() const noexcept
     return lifeTimeFlag_;
 }
 
+namespace
+{
+// set while a reaper run is queued on the timer thread, retires coalesce
+std::atomic<bool> connectionReaperScheduled{};
+
+void schedule_connection_reaper(std::chrono::milliseconds delay)
+{
+    if (connectionReaperScheduled.exchange(true, std::memory_order_acq_rel))
+        return;
+
+    TimerHandle()->add_timer(delay,
+                             [](auto...)
+                             {
+                                 connectionReaperScheduled.store(false, std::memory_order_release);
+                                 // connections still pinned by a subscription
+                                 // round are retried on the next tick
+                                 if (!EpochDomainHandle()->reclaim_deferred())
+                                     schedule_connection_reaper(std::chrono::milliseconds(10));
+                             });
+}
+} // namespace
+
+std::shared_ptr<ConnectionState>
+ConnectionState::create(unique_connection&& connection, MOQT& moqtObject, Destruction destruction)
+{
+    auto* connectionState = new ConnectionState(std::move(connection), moqtObject);
+    if (destruction == Destruction::Direct)
+        return std::shared_ptr<ConnectionState>(connectionState);
+
+    return std::shared_ptr<ConnectionState>(connectionState,
+                                            [](ConnectionState* connectionState)
+                                            {
+                                                // the last reference may be dropped by a
+                                                // msquic worker, a publisher or a
+                                                // subscription thread, the shutdown runs
+                                                // on the timer thread instead
+                                                EpochDomainHandle()->retire_deferred(connectionState);
+                                                schedule_connection_reaper(
+                                                std::chrono::milliseconds(0));
+                                            });
+}
+
+ConnectionState::~ConnectionState()
+{
+    // the connection goes down before dataStreams, SHUTDOWN_COMPLETE of
+    // its streams then reports ConnectionShutdown and leaves them alone
+    if (connection_.get() != nullptr)
+        moqtObject_.get_tbl()->ConnectionShutdown(connection_.get(),
+                                                  QUIC_CONNECTION_SHUTDOWN_FLAG_NONE, 0);
+}
+
+// objects are sent on the stream of their subgroup
+static DataStreamKey send_key(const ObjectIdentifier& objectIdentifier) noexcept
+{
+    // TODO: get subgroupId
+    return DataStreamKey{ objectIdentifier.track_id().get(), objectIdentifier.groupId_.get(), 0 };
+}
+
+DataStreamState& ConnectionState::add_data_stream(DataStreams& dataStreams,
+                                                  rvn::unique_stream&& stream,
+                                                  std::optional<DataStreamKey> sendKey)
+{
+    dataStreams.emplace_back(std::move(stream), *this);
+    auto iter = std::prev(dataStreams.end());
+    dataStreamHandles_.emplace(iter->stream.get(), iter);
+    if (sendKey.has_value())
+    {
+        iter->sendKey_ = sendKey;
+        sendStreams_.insert_or_assign(*sendKey, iter);
+    }
+    return *iter;
+}
+
+rvn::unique_stream ConnectionState::erase_data_stream(DataStreams& dataStreams, DataStreamIterator iter)
+{
+    dataStreamHandles_.erase(iter->stream.get());
+    if (iter->sendKey_.has_value())
+        unindex_send_stream(iter);
+    rvn::unique_stream stream = std::move(iter->stream);
+    dataStreams.erase(iter);
+    return stream;
+}
+
+void ConnectionState::unindex_send_stream(DataStreamIterator iter)
+{
+    auto sendIter = sendStreams_.find(*iter->sendKey_);
+    if (sendIter != sendStreams_.end() && sendIter->second == iter)
+        sendStreams_.erase(sendIter);
+    iter->sendKey_.reset();
+}
+
+std::optional<ConnectionState::DataStreamIterator> ConnectionState::find_data_stream(HQUIC streamHandle) const
+{
+    auto iter = dataStreamHandles_.find(streamHandle);
+    if (iter == dataStreamHandles_.end())
+        return std::nullopt;
+    return iter->second;
+}
+
+std::optional<ConnectionState::DataStreamIterator>
+ConnectionState::find_send_stream(const ObjectIdentifier& objectIdentifier) const
+{
+    auto iter = sendStreams_.find(send_key(objectIdentifier));
+    if (iter == sendStreams_.end())
+        return std::nullopt;
+    return iter->second;
+}
+
 void ConnectionState::delete_data_stream(HQUIC streamHandle)
 {
     dataStreams.write(
-    [&streamHandle](StableContainer<DataStreamState>& dataStreams)
+    [&streamHandle, this](DataStreams& dataStreams)
     {
-        auto iter =
-        std::find_if(dataStreams.begin(), dataStreams.end(),
-                     [&streamHandle](const DataStreamState& streamState)
-                     { return streamState.stream.get() == streamHandle; });
+        // pooled streams reset by the peer before they were taken, under the
+        // lock of dataStreams so that they are not taken meanwhile
+        drop_pooled_stream(streamHandle);
 
-        dataStreams.erase(iter);
+        // streams aborted earlier are gone already
+        if (auto iter = find_data_stream(streamHandle))
+        {
+            // the stream is shut down, nothing left to abort
+            (*iter)->stream.release();
+            std::ignore = erase_data_stream(dataStreams, *iter);
+        }
     });
 }
 
@@ -80,12 +222,18 @@ void ConnectionState::send_control_buffer(QUIC_BUFFER* buffer, QUIC_SEND_FLAGS f
     HQUIC streamHandle = streamState->stream.get();
 
     StreamSendContext* streamSendContext =
-    new StreamSendContext(buffer, 1, streamState->streamContext_, std::nullopt);
+    new StreamSendContext(SharedQuicBuffer::adopt(buffer), streamState->streamContext_,
+                          std::nullopt);
 
     QUIC_STATUS status =
-    moqtObject_.get_tbl()->StreamSend(streamHandle, buffer, 1, flags, streamSendContext);
+    moqtObject_.get_tbl()->StreamSend(streamHandle, streamSendContext->quicBuffers_.data(), 1,
+                                      flags, streamSendContext);
     if (QUIC_FAILED(status))
+    {
+        // SEND_COMPLETE is not indicated for failed sends
+        delete streamSendContext;
         throw std::runtime_error("Failed to send control message");
+    }
 }
 
 const std::optional<StreamState>& ConnectionState::get_control_stream() const
@@ -102,13 +250,12 @@ QUIC_STATUS ConnectionState::accept_data_stream(HQUIC streamHandle)
 {
     // register new data stream into connectionState object
     return dataStreams.write(
-    [&](StableContainer<DataStreamState>& dataStreams)
+    [&](DataStreams& dataStreams)
     {
-        dataStreams.emplace_back(rvn::unique_stream(moqtObject_.get_tbl(), streamHandle),
-                                 *this);
+        DataStreamState& streamState =
+        add_data_stream(dataStreams, rvn::unique_stream(moqtObject_.get_tbl(), streamHandle));
 
         // set stream context for stream
-        DataStreamState& streamState = dataStreams.back();
         streamState.set_stream_context(new StreamContext(moqtObject_, *this));
         streamState.streamContext_->construct_deserializer(streamState, false);
 
@@ -156,133 +303,456 @@ StreamState& ConnectionState::establish_control_stream()
     return this->controlStream.value();
 }
 
-QUIC_STATUS ConnectionState::send_object(const ObjectIdentifier& objectIdentifier,
-                                         QUIC_BUFFER* objectPayload,
-                                         PublisherPriority publisherPriority,
-                                         std::optional<std::chrono::milliseconds> timeoutDuration)
+QUIC_STATUS ConnectionState::send_objects(std::span<ScheduledObject> scheduledObjects)
 {
-    auto sendObjectLambda = [&](const StableContainer<DataStreamState>& dataStreams)
+    const ScheduledObject& firstObject = scheduledObjects.front();
+    const ObjectIdentifier& objectIdentifier = firstObject.objectIdentifier_;
+
+    // the earliest deadline of the objects applies to the whole send
+    std::optional<std::chrono::milliseconds> timeoutDuration;
+    for (const auto& scheduledObject : scheduledObjects)
+        if (scheduledObject.timeoutDuration_.has_value() &&
+            (!timeoutDuration.has_value() || *scheduledObject.timeoutDuration_ < *timeoutDuration))
+            timeoutDuration = scheduledObject.timeoutDuration_;
+
+    std::optional<TimePoint> timeoutTimePoint;
+    if (timeoutDuration.has_value())
+        timeoutTimePoint = Clock::now() + *timeoutDuration;
+
+    // the end of the group is always last in its run, the stream is
+    // finished with the objects before it
+    bool endOfGroup = scheduledObjects.back().endOfGroup_;
+    QUIC_SEND_FLAGS sendFlags = QUIC_SEND_FLAG_EVENT_ON_FIRST_COPY_TO_FRAME;
+    if (endOfGroup)
+        sendFlags |= QUIC_SEND_FLAG_FIN;
+
+    StreamSendContext::Buffers buffers;
+    for (auto& scheduledObject : scheduledObjects.first(scheduledObjects.size() - endOfGroup))
+        buffers.push_back(std::move(scheduledObject.payload_));
+
+    auto sendObjectsLambda = [&](auto&)
     {
-        auto iter =
-        std::find_if(dataStreams.begin(), dataStreams.end(),
-                     [&objectIdentifier](const DataStreamState& streamState)
-                     { return streamState.can_send_object(objectIdentifier); });
+        auto iter = find_send_stream(objectIdentifier);
 
         // We return this to indicate that we have not found a stream to send
         // the object This is not an error, we just need to create a new stream
         // to send the object We never expect StreamSend to return
         // `QUIC_STATUS_ALPN_NEG_FAILURE`, hence if it was returned, the intent
         // is clear
-        if (iter == dataStreams.end())
+        if (!iter.has_value())
             return QUIC_STATUS_ALPN_NEG_FAILURE;
 
-
-        std::optional<TimePoint> timeoutTimePoint;
-
-        if (timeoutDuration.has_value())
-            timeoutTimePoint = Clock::now() + *timeoutDuration;
-
         StreamSendContext* streamSendContext =
-        new StreamSendContext(objectPayload, 1, iter->streamContext_, timeoutTimePoint);
+        new StreamSendContext(std::move(buffers), (*iter)->streamContext_, timeoutTimePoint);
 
+        auto [quicBuffers, numQuicBuffers] = streamSendContext->get_buffers();
         auto streamSendRet =
-        moqtObject_.get_tbl()->StreamSend(iter->stream.get(), objectPayload, 1,
-                                          QUIC_SEND_FLAG_EVENT_ON_FIRST_COPY_TO_FRAME,
-                                          streamSendContext);
+        moqtObject_.get_tbl()->StreamSend((*iter)->stream.get(), quicBuffers, numQuicBuffers,
+                                          sendFlags, streamSendContext);
+
+        // SEND_COMPLETE is not indicated for failed sends
+        if (QUIC_FAILED(streamSendRet))
+            delete streamSendContext;
+        else if (endOfGroup)
+            // objects of the group showing up later go on a new stream, the
+            // state is freed on SHUTDOWN_COMPLETE
+            unindex_send_stream(*iter);
         return streamSendRet;
     };
 
-    QUIC_STATUS trySendStatus = dataStreams.read(sendObjectLambda);
+    // finishing takes the stream out of the index
+    QUIC_STATUS trySendStatus =
+    endOfGroup ? dataStreams.write(sendObjectsLambda) : dataStreams.read(sendObjectsLambda);
+    if (trySendStatus != QUIC_STATUS_ALPN_NEG_FAILURE)
+        return trySendStatus;
 
-    if (trySendStatus == QUIC_STATUS_ALPN_NEG_FAILURE)
+    // nothing of the group was sent, there is no stream to finish
+    if (buffers.empty())
+        return QUIC_STATUS_SUCCESS;
+
+    // sends are serialized by sendSchedulerMtx_, nobody opens the stream of
+    // the group in the meantime
+
+    // header message
+    StreamHeaderSubgroupMessage objectHeader;
+    // TODO: add error handling to this
+    objectHeader.trackAlias_ = identifier_to_alias(objectIdentifier).value();
+    objectHeader.groupId_ = objectIdentifier.groupId_;
+    // TOOD: get subgroupId
+    objectHeader.subgroupId_ = SubGroupId(0);
+
+    // Get publisher priority from group
+    objectHeader.publisherPriority_ = firstObject.publisherPriority_;
+
+    // the header goes out in the same send as the first objects
+    buffers.insert(buffers.begin(), SharedQuicBuffer::adopt(serialization::serialize(objectHeader)));
+
+    auto [streamHandle, streamSendContext] = dataStreams.write(
+    [&, this](DataStreams& dataStreams)
     {
-        // header message
-        StreamHeaderSubgroupMessage objectHeader;
-        // TODO: add error handling to this
-        objectHeader.trackAlias_ = identifier_to_alias(objectIdentifier).value();
-        objectHeader.groupId_ = objectIdentifier.groupId_;
-        // TOOD: get subgroupId
-        objectHeader.subgroupId_ = SubGroupId(0);
-
-        // Get publisher priority from group
-        objectHeader.publisherPriority_ = publisherPriority;
-
-        QUIC_BUFFER* objectHeaderQuicBuffer = serialization::serialize(objectHeader);
-
-        // Create a new stream and send the object
-        StreamContext* streamContext = new StreamContext(moqtObject_, *this);
-
-        // TODO: do error handling here
-        auto stream =
-        rvn::unique_stream(moqtObject_.get_tbl(),
-                           { connection_.get(), QUIC_STREAM_OPEN_FLAG_UNIDIRECTIONAL,
-                             moqtObject_.data_stream_cb_wrapper, streamContext },
-                           { QUIC_STREAM_START_FLAG_NONE });
-
-        auto [streamHandle, streamSendContext] = dataStreams.write(
-        [&, streamIn = std::move(stream), this](StableContainer<DataStreamState>& dataStreams) mutable
-        {
-            dataStreams.emplace_back(std::move(streamIn), *this);
-            DataStreamState& streamState = dataStreams.back();
-            streamState.set_header(objectHeader);
-            streamState.set_stream_context(streamContext);
+        // a pre-opened stream if there is one, the pool is topped up once
+        // the objects are on their way
+        PooledStream pooledStream = take_data_stream();
+
+        std::optional<DataStreamKey> sendKey;
+        if (!endOfGroup)
+            sendKey = send_key(objectIdentifier);
+        DataStreamState& streamState =
+        add_data_stream(dataStreams, std::move(pooledStream.stream_), sendKey);
+        streamState.set_header(objectHeader);
+        streamState.set_stream_context(pooledStream.streamContext_);
+
+        // no need deserializer because we don't expect to receive any
+        // messages on this stream
+
+        StreamSendContext* streamSendContext =
+        new StreamSendContext(std::move(buffers), streamState.streamContext_, timeoutTimePoint);
 
-            // no need deserializer because we don't expect to receive any
-            // messages on this stream
+        return std::make_tuple(streamState.stream.get(), streamSendContext);
+    });
 
-            StreamSendContext* streamSendContext =
-            new StreamSendContext(objectHeaderQuicBuffer, 1,
-                                  streamState.streamContext_, std::nullopt);
+    // Set priority of stream to indicate the priority of the group
+    // MsQuic uses uint16_t stream priority and sends higher values first,
+    // moqt uses 8 bit priorities where lower values are more important.
+    // Subscriber priority takes precedence over publisher priority
+    std::uint16_t streamPriority = static_cast<std::uint16_t>(
+    0xFFFF - (firstObject.subscriberPriority_.get() << 8 | firstObject.publisherPriority_.get()));
+    moqtObject_.get_tbl()->SetParam(streamHandle, QUIC_PARAM_STREAM_PRIORITY,
+                                    sizeof(std::uint16_t), &streamPriority);
 
-            return std::make_tuple(streamState.stream.get(), streamSendContext);
+    auto [quicBuffers, numQuicBuffers] = streamSendContext->get_buffers();
+    QUIC_STATUS status =
+    moqtObject_.get_tbl()->StreamSend(streamHandle, quicBuffers, numQuicBuffers, sendFlags,
+                                      streamSendContext);
+    if (QUIC_FAILED(status))
+    {
+        delete streamSendContext;
+        // nothing went out on the stream, it must not take the next objects
+        // of the group, aborted once the lock is released
+        rvn::unique_stream stream = dataStreams.write(
+        [&](DataStreams& dataStreams)
+        {
+            if (auto iter = find_data_stream(streamHandle))
+                return erase_data_stream(dataStreams, *iter);
+            return rvn::unique_stream();
         });
+        return status;
+    }
 
-        // Set priority of stream to indicate the priority of the group
-        // MsQuic uses uint16_t stream priority, unlike moqt which uses 8 bit
-        std::uint16_t streamPriority = objectHeader.publisherPriority_;
-        moqtObject_.get_tbl()->SetParam(streamHandle, QUIC_PARAM_STREAM_PRIORITY,
-                                        sizeof(std::uint16_t), &streamPriority);
+    schedule_stream_pool_replenish();
+
+    /*
+        Draft specifies that timeout should start from when it receives the
+       object, but we set it from when we start sending the object
+
+        TODO: check if we can set it from when the object is received (Talk
+       to Alan)
+    */
+    if (timeoutDuration)
+        TimerHandle()->add_timer(*timeoutDuration,
+                                 [objectIdentifier,
+                                  connState = this->weak_from_this()](auto...)
+                                 {
+                                     if (auto connStateSharedPtr = connState.lock())
+                                         connStateSharedPtr->abort_if_sending(objectIdentifier);
+                                 });
+
+    return status;
+}
 
-        QUIC_STATUS status =
-        moqtObject_.get_tbl()->StreamSend(streamHandle, objectHeaderQuicBuffer, 1,
-                                          QUIC_SEND_FLAG_NONE, streamSendContext);
-
-        /*
-            Draft specifies that timeout should start from when it receives the
-           object, but we set it from when we start sending the object
-
-            TODO: check if we can set it from when the object is received (Talk
-           to Alan)
-        */
-        if (timeoutDuration)
-            TimerHandle()->add_timer(*timeoutDuration,
-                                     [objectIdentifier,
-                                      connState = this->weak_from_this()](auto...)
-                                     {
-                                         if (auto connStateSharedPtr = connState.lock())
-                                             connStateSharedPtr->abort_if_sending(objectIdentifier);
-                                     });
+QUIC_STATUS ConnectionState::send_datagrams(std::span<ScheduledObject> scheduledObjects)
+{
+    const ObjectIdentifier& objectIdentifier = scheduledObjects.front().objectIdentifier_;
+    // TODO: add error handling to this
+    TrackAlias trackAlias = identifier_to_alias(objectIdentifier).value();
+    std::uint64_t maxDatagramLength = maxDatagramLength_.load(std::memory_order_relaxed);
 
+    for (auto& scheduledObject : scheduledObjects)
+    {
+        // the stream of the group only exists if some objects did not fit
+        if (scheduledObject.endOfGroup_)
+            return send_objects({ &scheduledObject, 1 });
+
+        ObjectDatagramHeader header{ trackAlias, objectIdentifier.groupId_,
+                                     scheduledObject.objectIdentifier_.objectId_,
+                                     scheduledObject.publisherPriority_ };
+        DatagramSendContext::HeaderBytes headerBytes;
+        std::uint32_t headerLength =
+        static_cast<std::uint32_t>(serialization::detail::serialize(headerBytes, header));
+
+        std::uint32_t objectOffset = Object::payload_length_offset(scheduledObject.payload_);
+        std::uint64_t datagramLength =
+        headerLength + scheduledObject.payload_->Length - objectOffset;
+        if (datagramLength > maxDatagramLength)
+        {
+            QUIC_STATUS status = send_objects({ &scheduledObject, 1 });
+            if (QUIC_FAILED(status))
+                return status;
+            continue;
+        }
+
+        DatagramSendContext* datagramSendContext =
+        new DatagramSendContext(headerBytes, headerLength,
+                                std::move(scheduledObject.payload_), objectOffset, *this);
+
+        QUIC_STATUS status =
+        moqtObject_.get_tbl()->DatagramSend(connection_.get(),
+                                            datagramSendContext->quicBuffers_.data(),
+                                            datagramSendContext->quicBuffers_.size(),
+                                            QUIC_SEND_FLAG_NONE, datagramSendContext);
+        // DATAGRAM_SEND_STATE_CHANGED is not indicated for failed sends
         if (QUIC_FAILED(status))
+        {
+            delete datagramSendContext;
             return status;
+        }
+    }
 
-        return send_object(objectIdentifier, objectPayload, publisherPriority, timeoutDuration);
+    return QUIC_STATUS_SUCCESS;
+}
+
+void ConnectionState::receive_datagram(const QUIC_BUFFER& buffer)
+{
+    if (!controlStream.has_value())
+        return;
+
+    // a datagram is one whole message, read in place as the buffer belongs
+    // to msquic and is only valid during the callback
+    ds::ByteSpan span(buffer.Buffer, buffer.Length);
+    ObjectDatagramMessage objectDatagramMessage;
+    if (serialization::detail::deserialize(objectDatagramMessage, span) == 0 || span.size() != 0)
+    {
+        LOGE("Dropping datagram which is not one object datagram");
+        return;
     }
 
-    return trySendStatus;
+    MessageHandler(*controlStream, nullptr)(std::move(objectDatagramMessage));
+}
+
+bool ConnectionState::schedule_object(ScheduledObject scheduledObject, bool supersede)
+{
+    {
+        std::unique_lock l(sendSchedulerMtx_);
+        sendScheduler_.push(std::move(scheduledObject), supersede);
+        scheduledBytes_.store(sendScheduler_.num_bytes(), std::memory_order_seq_cst);
+    }
+    // the first one to schedule after a flush flushes
+    return !flushPending_.exchange(true, std::memory_order_acq_rel);
+}
+
+bool ConnectionState::flush_scheduled_objects()
+{
+    // cleared before draining, objects scheduled before this are drained
+    // below and objects scheduled after it get a flush of their own
+    flushPending_.store(false, std::memory_order_release);
+
+    std::unique_lock l(sendSchedulerMtx_);
+    bool sendFailed = false;
+    while (!sendScheduler_.empty())
+    {
+        if (bytesInFlight_.load(std::memory_order_seq_cst) >=
+            idealSendBufferSize_.load(std::memory_order_relaxed))
+        {
+            sendBlocked_.store(true, std::memory_order_seq_cst);
+            // a send which completed before the flag was set did not notify
+            if (bytesInFlight_.load(std::memory_order_seq_cst) >=
+                idealSendBufferSize_.load(std::memory_order_relaxed))
+                break;
+            continue;
+        }
+
+        // consecutive objects of a group go out in one send, bounded by
+        // what is left of the budget
+        std::uint64_t idealSendBufferSize = idealSendBufferSize_.load(std::memory_order_relaxed);
+        std::uint64_t bytesInFlight = bytesInFlight_.load(std::memory_order_relaxed);
+        std::uint64_t budget =
+        bytesInFlight < idealSendBufferSize ? idealSendBufferSize - bytesInFlight : 0;
+        sendRun_.clear();
+        sendScheduler_.pop_run(sendRun_, maxObjectsPerSend, budget);
+        scheduledBytes_.store(sendScheduler_.num_bytes(), std::memory_order_seq_cst);
+
+        QUIC_STATUS status =
+        sendRun_.front().datagram_ ? send_datagrams(sendRun_) : send_objects(sendRun_);
+        sendRun_.clear();
+        if (QUIC_FAILED(status))
+        {
+            // the connection is going away, the objects left die with it
+            sendFailed = true;
+            break;
+        }
+    }
+    bool hasBacklog = !sendScheduler_.empty();
+    l.unlock();
+
+    // subscriptions stopped by the scheduled bytes can go on
+    if (has_send_budget() && sendBlocked_.exchange(false, std::memory_order_seq_cst) &&
+        activityNotifier_ != nullptr)
+        activityNotifier_->notify();
+
+    if (!hasBacklog || sendFailed)
+        return false;
+    // somebody scheduled in the meantime and flushes instead of us
+    return !flushPending_.exchange(true, std::memory_order_acq_rel);
+}
+
+void ConnectionState::on_send_started(std::uint64_t numBytes) noexcept
+{
+    bytesInFlight_.fetch_add(numBytes, std::memory_order_relaxed);
+}
+
+void ConnectionState::on_send_completed(std::uint64_t numBytes) noexcept
+{
+    // seq cst pairs with the senders setting sendBlocked_, either they
+    // observe the decrement or we observe the flag
+    std::uint64_t bytesInFlight =
+    bytesInFlight_.fetch_sub(numBytes, std::memory_order_seq_cst) - numBytes;
+    if (bytesInFlight < idealSendBufferSize_.load(std::memory_order_relaxed) &&
+        sendBlocked_.exchange(false, std::memory_order_seq_cst) && activityNotifier_ != nullptr)
+        activityNotifier_->notify();
+}
+
+void ConnectionState::set_ideal_send_buffer_size(std::uint64_t idealSendBufferSize) noexcept
+{
+    std::uint64_t previous =
+    idealSendBufferSize_.exchange(idealSendBufferSize, std::memory_order_seq_cst);
+    if (idealSendBufferSize > previous && sendBlocked_.exchange(false, std::memory_order_seq_cst) &&
+        activityNotifier_ != nullptr)
+        activityNotifier_->notify();
+}
+
+std::optional<WaitSignal> ConnectionState::wait_for_send_budget()
+{
+    if (activityNotifier_ == nullptr || has_send_budget()) [[likely]]
+        return std::nullopt;
+
+    // observed before publishing the flag, a notify after it sets the signal
+    WaitSignal budgetSignal(*activityNotifier_);
+    sendBlocked_.store(true, std::memory_order_seq_cst);
+    if (has_send_budget())
+        return std::nullopt;
+    return budgetSignal;
+}
+
+ConnectionState::PooledStream ConnectionState::open_data_stream()
+{
+    // owned by the stream once it is open and started (freed on
+    // SHUTDOWN_COMPLETE), freed here if opening or starting throws
+    auto streamContext = std::make_unique<StreamContext>(moqtObject_, *this);
+
+    auto stream =
+    rvn::unique_stream(moqtObject_.get_tbl(),
+                       { connection_.get(), QUIC_STREAM_OPEN_FLAG_UNIDIRECTIONAL,
+                         moqtObject_.data_stream_cb_wrapper, streamContext.get() },
+                       { QUIC_STREAM_START_FLAG_NONE });
+
+    return PooledStream{ std::move(stream), streamContext.release() };
+}
+
+ConnectionState::PooledStream ConnectionState::take_data_stream()
+{
+    {
+        std::unique_lock l(streamPoolMtx_);
+        if (!streamPool_.empty())
+        {
+            PooledStream pooledStream = std::move(streamPool_.back());
+            streamPool_.pop_back();
+            return pooledStream;
+        }
+        // opened on the spot, still uses up one of the streams of the peer
+        if (numAvailableStreams_ != 0)
+            numAvailableStreams_--;
+    }
+    return open_data_stream();
+}
+
+void ConnectionState::drop_pooled_stream(HQUIC streamHandle)
+{
+    std::unique_lock l(streamPoolMtx_);
+    auto iter = std::find_if(streamPool_.begin(), streamPool_.end(),
+                             [streamHandle](const PooledStream& pooledStream)
+                             { return pooledStream.stream_.get() == streamHandle; });
+    if (iter == streamPool_.end())
+        return;
+
+    // the stream is shut down, nothing left to abort
+    iter->stream_.release();
+    streamPool_.erase(iter);
+}
+
+void ConnectionState::schedule_stream_pool_replenish()
+{
+    {
+        std::unique_lock l(streamPoolMtx_);
+        if (replenishPending_ || numAvailableStreams_ == 0 ||
+            streamPool_.size() + numPooling_ >= streamPoolSize)
+            return;
+        replenishPending_ = true;
+    }
+
+    // opening streams is kept off the sending path
+    TimerHandle()->add_timer(std::chrono::milliseconds(0),
+                             [connState = this->weak_from_this()](auto...)
+                             {
+                                 if (auto connStateSharedPtr = connState.lock())
+                                     connStateSharedPtr->replenish_stream_pool();
+                             });
+}
+
+void ConnectionState::replenish_stream_pool()
+{
+    std::size_t numToOpen;
+    {
+        std::unique_lock l(streamPoolMtx_);
+        replenishPending_ = false;
+        std::size_t numPooled = streamPool_.size() + numPooling_;
+        numToOpen = numPooled < streamPoolSize ? streamPoolSize - numPooled : 0;
+        numToOpen = std::min<std::uint64_t>(numToOpen, numAvailableStreams_);
+        numAvailableStreams_ -= numToOpen;
+        numPooling_ += numToOpen;
+    }
+
+    for (std::size_t i = 0; i < numToOpen; i++)
+    {
+        std::optional<PooledStream> pooledStream;
+        try
+        {
+            pooledStream.emplace(open_data_stream());
+        }
+        catch (const std::runtime_error& e)
+        {
+            // groups open their stream themselves then
+            LOGE("Failed to pre-open data stream", e.what());
+        }
+
+        std::unique_lock l(streamPoolMtx_);
+        numPooling_--;
+        if (pooledStream.has_value())
+            streamPool_.push_back(std::move(*pooledStream));
+    }
+}
+
+void ConnectionState::set_available_streams(std::uint64_t numAvailableStreams)
+{
+    {
+        std::unique_lock l(streamPoolMtx_);
+        numAvailableStreams_ = numAvailableStreams;
+    }
+    replenish_stream_pool();
 }
 
 void ConnectionState::abort_if_sending(const ObjectIdentifier& oid)
 {
-    dataStreams.write(
-    [&](StableContainer<DataStreamState>& dataStreams)
+    // aborted once the lock is released
+    rvn::unique_stream stream = dataStreams.write(
+    [&](DataStreams& dataStreams)
     {
-        auto iter = std::find_if(dataStreams.begin(), dataStreams.end(),
-                                 [&](DataStreamState& streamState)
-                                 { return streamState.can_send_object(oid); });
+        auto iter = find_send_stream(oid);
 
-        if (iter != dataStreams.end())
-            dataStreams.erase(iter);
+        // streams which sent everything are kept for the next objects
+        if (iter.has_value() &&
+            (*iter)->streamContext_->numPendingSends_.load(std::memory_order_acquire) != 0)
+            return erase_data_stream(dataStreams, *iter);
+        return rvn::unique_stream();
     });
 }
 
@@ -291,7 +761,7 @@ std::optional<GroupId> ConnectionState::get_current_group(const TrackIdentifier&
     // reader lock
     std::shared_lock<std::shared_mutex> l(currGroupMtx_);
 
-    auto iter = currGroupMap_.find(trackIdentifier);
+    auto iter = currGroupMap_.find(trackIdentifier.track_id());
     if (iter == currGroupMap_.end())
         return std::nullopt;
 
@@ -313,7 +783,7 @@ void ConnectionState::add_track_alias(TrackIdentifier trackIdentifier, TrackAlia
     // writer lock
     std::unique_lock<std::shared_mutex> l(trackAliasMtx_);
 
-    trackAliasMap_.emplace(trackIdentifier, trackAlias);
+    trackAliasMap_.emplace(trackIdentifier.track_id(), trackAlias);
     trackAliasRevMap_.emplace(trackAlias, std::move(trackIdentifier));
 }
 
@@ -335,7 +805,7 @@ ConnectionState::identifier_to_alias(const TrackIdentifier& trackIdentifier)
     // reader lock
     std::shared_lock<std::shared_mutex> l(trackAliasMtx_);
 
-    auto iter = trackAliasMap_.find(trackIdentifier);
+    auto iter = trackAliasMap_.find(trackIdentifier.track_id());
     if (iter == trackAliasMap_.end())
         return std::nullopt;
 
@@ -1,18 +1,71 @@
 #include "strong_types.hpp"
+#include <algorithm>
 #include <atomic>
 #include <cstdio>
 #include <data_manager.hpp>
-#include <filesystem>
 #include <memory>
 
 namespace rvn
 {
 
 
+std::uint64_t TrackIdentifierRegistry::hash(const std::vector<std::string>& tracknamespace,
+                                            const std::string& trackname)
+{
+    std::uint64_t hash = 0;
+    for (const auto& ns : tracknamespace)
+        boost::hash_combine(hash, ns);
+
+    boost::hash_combine(hash, trackname);
+    return hash;
+}
+
+const TrackIdentifierRegistry::Entry*
+TrackIdentifierRegistry::find(const Entries& entries,
+                              std::uint64_t hash,
+                              const std::vector<std::string>& tracknamespace,
+                              const std::string& trackname)
+{
+    auto [beginIter, endIter] = entries.equal_range(hash);
+    for (auto iter = beginIter; iter != endIter; ++iter)
+        if (iter->second.tnamespace_ == tracknamespace && iter->second.tname_ == trackname)
+            return &iter->second;
+    return nullptr;
+}
+
+const TrackIdentifierRegistry::Entry&
+TrackIdentifierRegistry::intern(std::vector<std::string> tracknamespace, std::string trackname)
+{
+    std::uint64_t hash = TrackIdentifierRegistry::hash(tracknamespace, trackname);
+
+    const Entry* entry =
+    entries_.read(hash, [&](const Entries& entries)
+                  { return find(entries, hash, tracknamespace, trackname); });
+    if (entry != nullptr) [[likely]]
+        return *entry;
+
+    return entries_.write(hash,
+                          [&](Entries& entries) -> const Entry&
+                          {
+                              // someone else might have interned it in between
+                              if (const Entry* entry = find(entries, hash, tracknamespace, trackname))
+                                  return *entry;
+
+                              TrackId trackId(nextTrackId_.fetch_add(1, std::memory_order_relaxed));
+                              return entries
+                              .emplace(hash, Entry{ trackId, hash, std::move(tracknamespace),
+                                                    std::move(trackname) })
+                              ->second;
+                          });
+}
+
+std::uint64_t TrackIdentifierRegistry::size() const noexcept
+{
+    return nextTrackId_.load(std::memory_order_relaxed);
+}
+
 TrackIdentifier::TrackIdentifier(std::vector<std::string> trackNamespace, std::string tname)
-: trackIdentifierInternal_(
-  std::make_shared<std::pair<std::vector<std::string>, std::string>>(std::move(trackNamespace),
-                                                                     std::move(tname)))
+: entry_(&TrackIdentifierRegistryHandle()->intern(std::move(trackNamespace), std::move(tname)))
 {
 }
 
@@ -34,161 +87,481 @@ ObjectIdentifier::ObjectIdentifier(GroupIdentifier groupIdentifier, ObjectId obj
 TrackHandle::TrackHandle(DataManager& dataManagerHandle,
                          TrackIdentifier trackIdentifier,
                          PublisherPriority publisherPriority,
-                         std::optional<std::chrono::milliseconds> deliveryTimeout)
+                         std::optional<std::chrono::milliseconds> deliveryTimeout,
+                         RetentionPolicy retentionPolicy,
+                         std::unique_ptr<EpochNotifier> updateNotifier)
 : dataManager_(dataManagerHandle), trackIdentifier_(std::move(trackIdentifier)),
   publisherPriority_(publisherPriority), deliveryTimeout_(deliveryTimeout),
-  // no update yet, waiting for it
-  updateSignal_(std::make_shared<std::atomic<WaitStatus>>(WaitStatus::Wait))
+  retentionPolicy_(retentionPolicy), updateNotifier_(std::move(updateNotifier))
 {
-    // create directory if it does not exist
-    std::string pathString = dataManager_.get_path_string(trackIdentifier_);
-    std::filesystem::create_directories(pathString);
+    if (dataManager_.storagePolicy_.dataDirectory_.has_value())
+    {
+        // creates the track directory if it does not exist
+        segmentLog_ =
+        std::make_unique<SegmentLog>(dataManager_.get_path_string(trackIdentifier_),
+                                     dataManager_.storagePolicy_.segmentLogOptions_);
+        reload_latest_group();
+    }
 }
 
-EnrichedObjectOrWait TrackHandle::get_first_object()
+void TrackHandle::reload_latest_group()
 {
+    std::optional<GroupId> latestGroupId = segmentLog_->latest_group_id();
+    if (!latestGroupId.has_value())
+        return;
+
+    // older groups are served from the log
+    coldGroupEnd_.store(*latestGroupId, std::memory_order_relaxed);
+
+    // payloads stay in the mapping, the store borrows them
     std::unique_lock l(mtx_);
+    for (const auto& record : segmentLog_->group_records(*latestGroupId))
+    {
+        auto [groupId, objectId, object] = make_cold_object(record);
+        emplace_object(groupId, objectId, std::move(object));
+    }
+}
+
+bool TrackHandle::emplace_object(GroupId groupId, ObjectId objectId, Object object)
+{
+    // evicted groups are history, they are only served from the log
+    if (groupId < coldGroupEnd_.load(std::memory_order_relaxed))
+        return false;
+
+    std::uint64_t numBytesBefore = objects_.num_bytes();
+    std::uint64_t numGroupsBefore = objects_.num_groups();
+
+    if (!objects_.emplace(groupId, objectId, std::move(object)))
+        return false;
+
+    if (objects_.num_groups() != numGroupsBefore && dataManager_.has_global_limits())
+        newGroups_.push_back(groupId);
+
+    dataManager_.numBytes_.fetch_add(objects_.num_bytes() - numBytesBefore,
+                                     std::memory_order_relaxed);
+    dataManager_.numGroups_.fetch_add(objects_.num_groups() - numGroupsBefore,
+                                      std::memory_order_relaxed);
+    return true;
+}
+
+bool TrackHandle::publish_object(GroupId groupId, ObjectId objectId, Object object)
+{
+    EnrichedObjectType enrichedObject(groupId, objectId, std::move(object));
+    return publish_objects({ &enrichedObject, 1 }) == 1;
+}
+
+std::uint64_t TrackHandle::publish_objects(std::span<EnrichedObjectType> objects)
+{
+    std::uint64_t numPublished = 0;
+    std::vector<GroupId> newGroups;
+    {
+        std::unique_lock l(mtx_);
+        for (auto& [groupId, objectId, object] : objects)
+        {
+            // duplicates drop our reference on the payload
+            if (!emplace_object(groupId, objectId, object))
+                continue;
+
+            // persisted before retention may evict it from memory
+            dataManager_.store_object(*this, groupId, objectId, object);
+            numPublished++;
+        }
+
+        if (numPublished == 0)
+            return 0;
+
+        enforce_retention();
+        signal_update();
+        // also the groups reloaded by the constructor
+        newGroups.swap(newGroups_);
+    }
+
+    if (!newGroups.empty()) [[unlikely]]
+        dataManager_.add_eviction_candidates(shared_from_this(), newGroups);
+    enforce_global_retention();
+    return numPublished;
+}
+
+std::uint64_t TrackHandle::add_objects(std::span<ObjectBatchEntry> objects)
+{
+    std::vector<EnrichedObjectType> enrichedObjects;
+    enrichedObjects.reserve(objects.size());
+
+    for (auto& [groupId, objectId, data] : objects)
+        enrichedObjects.emplace_back(groupId, objectId,
+                                     Object::serialize_payload(objectId, std::move(data)));
+
+    return publish_objects(enrichedObjects);
+}
+
+void TrackHandle::signal_update()
+{
+    updateNotifier_->notify();
+    dataManager_.activityNotifier_.notify();
+}
+
+EnrichedObjectType TrackHandle::make_cold_object(const SegmentLog::Record& record) const
+{
+    auto object = [&record]() -> Object
+    {
+        switch (record.kind_)
+        {
+            case SegmentLog::RecordKind::GroupTerminator:
+                return Object::GroupTerminator{};
+            case SegmentLog::RecordKind::TrackTerminator:
+                return Object::TrackTerminator{};
+            default:
+                return record.payload_;
+        }
+    }();
+
+    // payload is borrowed, the log outlives the send
+    return std::make_tuple(record.groupId_, record.objectId_, std::move(object));
+}
+
+bool TrackHandle::evict_oldest_group()
+{
+    if (objects_.num_groups() <= 1)
+        return false;
+
+    std::uint64_t numBytesBefore = objects_.num_bytes();
+    // readers which miss the group in objects_ must find it in the log
+    if (segmentLog_ != nullptr)
+        coldGroupEnd_.store(objects_.oldest_group()->groupId_ + 1, std::memory_order_release);
+    objects_.evict_oldest_group();
+
+    dataManager_.numBytes_.fetch_sub(numBytesBefore - objects_.num_bytes(),
+                                     std::memory_order_relaxed);
+    dataManager_.numGroups_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+void TrackHandle::enforce_retention()
+{
+    std::optional<std::chrono::milliseconds> maxAge = retentionPolicy_.maxAge_;
+    if (!maxAge.has_value())
+        maxAge = dataManager_.globalRetentionPolicy_.maxAge_;
+
+    auto now = std::chrono::steady_clock::now();
+    while (objects_.num_groups() > 1)
+    {
+        bool exceedsGroups = retentionPolicy_.maxGroups_.has_value() &&
+                             objects_.num_groups() > *retentionPolicy_.maxGroups_;
+        bool exceedsBytes = retentionPolicy_.maxBytes_.has_value() &&
+                            objects_.num_bytes() > *retentionPolicy_.maxBytes_;
+        bool exceedsAge =
+        maxAge.has_value() && now - objects_.oldest_group()->createdAt_ > *maxAge;
+
+        if (!(exceedsGroups || exceedsBytes || exceedsAge))
+            break;
+
+        evict_oldest_group();
+    }
+}
 
-    auto beginObjectIter = objects_.begin();
+void TrackHandle::enforce_global_retention()
+{
+    if (dataManager_.exceeds_global_retention()) [[unlikely]]
+        dataManager_.enforce_global_retention();
+}
+
+EnrichedObjectOrWait TrackHandle::get_first_object()
+{
+    WaitSignal updateSignal(*updateNotifier_);
 
-    if (beginObjectIter != objects_.end())
+    auto entry = objects_.first();
+
+    // loaded after objects_, eviction publishes it before unlinking the group
+    std::uint64_t coldGroupEnd = coldGroupEnd_.load(std::memory_order_acquire);
+    if (coldGroupEnd != 0) [[unlikely]]
     {
-        auto [groupId, objectId] = beginObjectIter->first;
-        return std::make_tuple(groupId, objectId, beginObjectIter->second);
+        auto record = segmentLog_->first();
+        if (record.has_value() && record->groupId_ < coldGroupEnd)
+            return make_cold_object(*record);
     }
+
+    if (entry.has_value())
+        return std::make_tuple(entry->groupId_, entry->objectId_, std::move(entry->value_));
     else
-        return updateSignal_;
+        return updateSignal;
 }
 
 EnrichedObjectOrWait TrackHandle::get_next_object(const ObjectIdentifier& objectIdentifier)
 {
-    std::unique_lock l(mtx_);
+    WaitSignal updateSignal(*updateNotifier_);
 
-    auto iter = objects_.upper_bound(
-    std::make_tuple(objectIdentifier.groupId_, objectIdentifier.objectId_));
+    auto entry = objects_.next(objectIdentifier.groupId_, objectIdentifier.objectId_);
 
-    if (iter != objects_.end())
+    std::uint64_t coldGroupEnd = coldGroupEnd_.load(std::memory_order_acquire);
+    if (objectIdentifier.groupId_ < coldGroupEnd) [[unlikely]]
     {
-        auto [groupId, objectId] = iter->first;
-        return std::make_tuple(groupId, objectId, iter->second);
+        auto record = segmentLog_->next(objectIdentifier.groupId_, objectIdentifier.objectId_);
+        if (record.has_value() && record->groupId_ < coldGroupEnd)
+            return make_cold_object(*record);
     }
+
+    if (entry.has_value())
+        return std::make_tuple(entry->groupId_, entry->objectId_, std::move(entry->value_));
     else
-        return updateSignal_;
+        return updateSignal;
 }
 
+EnrichedObjectOrWait TrackHandle::get_object_at_or_after(GroupId groupId, ObjectId objectId)
+{
+    WaitSignal updateSignal(*updateNotifier_);
+
+    auto entry = objects_.lower_bound(groupId, objectId);
+
+    std::uint64_t coldGroupEnd = coldGroupEnd_.load(std::memory_order_acquire);
+    if (groupId < coldGroupEnd) [[unlikely]]
+    {
+        auto record = segmentLog_->lower_bound(groupId, objectId);
+        if (record.has_value() && record->groupId_ < coldGroupEnd)
+            return make_cold_object(*record);
+    }
+
+    if (entry.has_value())
+        return std::make_tuple(entry->groupId_, entry->objectId_, std::move(entry->value_));
+    else
+        return updateSignal;
+}
+
+std::optional<GroupId> TrackHandle::latest_group_id() const
+{
+    if (auto entry = objects_.latest())
+        return entry->groupId_;
+    // every group was evicted
+    if (segmentLog_ != nullptr)
+        return segmentLog_->latest_group_id();
+    return std::nullopt;
+}
 
 // returns EnrichedObject only if there is object later than oid
 EnrichedObjectOrWait
 TrackHandle::get_latest_object(const std::optional<ObjectIdentifier>& oid)
 {
-    std::unique_lock l(mtx_);
+    WaitSignal updateSignal(*updateNotifier_);
 
-    auto latestObjectIter = objects_.rbegin();
+    auto entry = objects_.latest();
 
-    if (latestObjectIter != objects_.rend())
+    if (entry.has_value())
         // either oid has no value or the latest object is later than oid
         if (!oid.has_value() || std::make_tuple(oid->groupId_, oid->objectId_) <
-                                latestObjectIter->first)
+                                std::make_tuple(entry->groupId_, entry->objectId_))
         {
-            auto [groupId, objectId] = latestObjectIter->first;
-            return std::make_tuple(groupId, objectId, latestObjectIter->second);
+            return std::make_tuple(entry->groupId_, entry->objectId_, std::move(entry->value_));
         }
-    return updateSignal_;
+    return updateSignal;
+}
+
+bool DataManager::has_global_limits() const noexcept
+{
+    return globalRetentionPolicy_.maxBytes_.has_value() ||
+           globalRetentionPolicy_.maxGroups_.has_value();
+}
+
+bool DataManager::exceeds_global_retention() const noexcept
+{
+    return (globalRetentionPolicy_.maxBytes_.has_value() &&
+            numBytes_.load(std::memory_order_relaxed) > *globalRetentionPolicy_.maxBytes_) ||
+           (globalRetentionPolicy_.maxGroups_.has_value() &&
+            numGroups_.load(std::memory_order_relaxed) > *globalRetentionPolicy_.maxGroups_);
+}
+
+void DataManager::enforce_global_retention()
+{
+    // some other publisher is already evicting
+    std::unique_lock evictionLock(globalEvictionMtx_, std::try_to_lock);
+    if (!evictionLock.owns_lock())
+        return;
+
+    // latest groups of their track, they become evictable later
+    std::vector<EvictionCandidate> blocked;
+
+    // evict the oldest group over all tracks
+    while (exceeds_global_retention() && !evictionCandidates_.empty())
+    {
+        std::pop_heap(evictionCandidates_.begin(), evictionCandidates_.end(), std::greater<>());
+        EvictionCandidate candidate = std::move(evictionCandidates_.back());
+        evictionCandidates_.pop_back();
+
+        auto trackHandle = candidate.trackHandle_.lock();
+        if (!trackHandle)
+            continue;
+
+        std::unique_lock l(trackHandle->mtx_);
+        auto oldestGroup = trackHandle->objects_.oldest_group();
+        // evicted by the limits of its track
+        if (!oldestGroup.has_value() || candidate.groupId_ < oldestGroup->groupId_)
+            continue;
+
+        if (trackHandle->objects_.num_groups() <= 1)
+        {
+            blocked.push_back(std::move(candidate));
+            continue;
+        }
+
+        // the store evicts by group id, a group published out of order may
+        // go before the candidate
+        GroupId evictedGroupId = oldestGroup->groupId_;
+        trackHandle->evict_oldest_group();
+        if (evictedGroupId != candidate.groupId_)
+        {
+            evictionCandidates_.push_back(std::move(candidate));
+            std::push_heap(evictionCandidates_.begin(), evictionCandidates_.end(), std::greater<>());
+        }
+    }
+
+    for (auto& candidate : blocked)
+    {
+        evictionCandidates_.push_back(std::move(candidate));
+        std::push_heap(evictionCandidates_.begin(), evictionCandidates_.end(), std::greater<>());
+    }
+}
+
+void DataManager::add_eviction_candidates(const std::shared_ptr<TrackHandle>& trackHandle,
+                                          std::span<const GroupId> groupIds)
+{
+    auto now = std::chrono::steady_clock::now();
+
+    std::unique_lock l(globalEvictionMtx_);
+    for (GroupId groupId : groupIds)
+    {
+        evictionCandidates_.push_back(EvictionCandidate{ now, trackHandle, groupId });
+        std::push_heap(evictionCandidates_.begin(), evictionCandidates_.end(), std::greater<>());
+    }
+
+    // groups evicted by the limits of their track pile up otherwise
+    if (evictionCandidates_.size() > 2 * numGroups_.load(std::memory_order_relaxed) + 64)
+        compact_eviction_candidates();
+}
+
+void DataManager::compact_eviction_candidates()
+{
+    // oldest group id in memory per track, nullopt if the track is gone
+    std::unordered_map<std::shared_ptr<TrackHandle>, std::optional<GroupId>> oldestGroupIds;
+    std::erase_if(evictionCandidates_,
+                  [&oldestGroupIds](const EvictionCandidate& candidate)
+                  {
+                      auto trackHandle = candidate.trackHandle_.lock();
+                      if (!trackHandle)
+                          return true;
+
+                      auto [iter, inserted] = oldestGroupIds.try_emplace(trackHandle);
+                      if (inserted)
+                      {
+                          std::unique_lock l(trackHandle->mtx_);
+                          if (auto oldestGroup = trackHandle->objects_.oldest_group())
+                              iter->second = oldestGroup->groupId_;
+                      }
+                      return !iter->second.has_value() || candidate.groupId_ < *iter->second;
+                  });
+    std::make_heap(evictionCandidates_.begin(), evictionCandidates_.end(), std::greater<>());
 }
 
 std::string DataManager::get_path_string(const TrackIdentifier& trackIdentifier)
 {
-    std::string pathString = std::string(DATA_DIRECTORY);
+    std::string pathString = *storagePolicy_.dataDirectory_;
     for (const auto& ns : trackIdentifier.tnamespace())
         pathString += ns + "/";
     pathString += trackIdentifier.tname() + "/";
     return pathString;
 }
 
-std::string DataManager::get_path_string(const GroupIdentifier& groupIdentifier)
+bool DataManager::store_object(TrackHandle& trackHandle, GroupId groupId, ObjectId objectId, const Object& object)
 {
-    return get_path_string(static_cast<const TrackIdentifier&>(groupIdentifier)) +
-           std::to_string(groupIdentifier.groupId_) + "/";
-}
+    if (trackHandle.segmentLog_ == nullptr)
+        return false;
 
-std::string DataManager::get_path_string(const ObjectIdentifier& objectIdentifier)
-{
-    return get_path_string(static_cast<const GroupIdentifier&>(objectIdentifier)) +
-           std::to_string(objectIdentifier.objectId_);
+    SegmentLog::RecordKind kind = SegmentLog::RecordKind::Payload;
+    if (object.is_track_terminator())
+        kind = SegmentLog::RecordKind::TrackTerminator;
+    else if (object.is_group_terminator())
+        kind = SegmentLog::RecordKind::GroupTerminator;
+
+    return trackHandle.segmentLog_->append(groupId, objectId, kind,
+                                           object.payload_.get());
 }
 
 std::weak_ptr<TrackHandle>
 DataManager::add_track_identifier(std::vector<std::string> tracknamespace,
                                   std::string trackname,
                                   PublisherPriority publisherPriority,
-                                  std::optional<std::chrono::milliseconds> deliveryTimeout)
+                                  std::optional<std::chrono::milliseconds> deliveryTimeout,
+                                  RetentionPolicy retentionPolicy)
 {
     auto trackIdentifier =
     TrackIdentifier(std::move(tracknamespace), std::move(trackname));
 
-    auto [trackHandleIter, success] = trackHandles_.write(
-    [&](auto& trackHandles)
+    auto [trackHandle, updateNotifier] = tracks_.write(
+    trackIdentifier.hash(),
+    [&](auto& tracks)
     {
-        return trackHandles.try_emplace(trackIdentifier,
-                                        std::make_shared<TrackHandle>(*this, trackIdentifier, publisherPriority,
-                                                                      deliveryTimeout));
+        TrackEntry& trackEntry = tracks[trackIdentifier];
+        if (trackEntry.trackHandle_)
+            return std::make_tuple(trackEntry.trackHandle_, static_cast<EpochNotifier*>(nullptr));
+
+        // subscribers may already wait on the pending notifier
+        std::unique_ptr<EpochNotifier> updateNotifier = std::move(trackEntry.pendingNotifier_);
+        if (!updateNotifier)
+            updateNotifier = std::make_unique<EpochNotifier>();
+
+        EpochNotifier* notifier = updateNotifier.get();
+        trackEntry.trackHandle_ =
+        std::make_shared<TrackHandle>(*this, trackIdentifier, publisherPriority,
+                                      deliveryTimeout, retentionPolicy, std::move(updateNotifier));
+        return std::make_tuple(trackEntry.trackHandle_, notifier);
     });
 
-    if (success)
+    // wake subscribers waiting for the track to be added
+    if (updateNotifier != nullptr)
     {
-        trackWaitSignals_.write(
-        [&trackIdentifier](auto& trackWaitSignals)
-        {
-            auto waitSignalIter = trackWaitSignals.find(trackIdentifier);
-            if (waitSignalIter != trackWaitSignals.end())
-            {
-                waitSignalIter->second->store(WaitStatus::Ready, std::memory_order::release);
-                trackWaitSignals.erase(waitSignalIter);
-            }
-        });
+        updateNotifier->notify();
+        activityNotifier_.notify();
     }
 
-    return trackHandleIter->second->weak_from_this();
+    return trackHandle->weak_from_this();
+}
+
+std::shared_ptr<TrackHandle>
+DataManager::find_track_handle(const TrackIdentifier& trackIdentifier) const
+{
+    return tracks_.read(trackIdentifier.hash(),
+                        [&trackIdentifier](const auto& tracks) -> std::shared_ptr<TrackHandle>
+                        {
+                            auto iter = tracks.find(trackIdentifier);
+                            if (iter == tracks.end())
+                                return nullptr;
+                            return iter->second.trackHandle_;
+                        });
 }
 
 std::variant<std::shared_ptr<TrackHandle>, WaitSignal>
 DataManager::get_track_handle(const TrackIdentifier& trackIdentifier)
 {
-    auto [trackHandleIter, isDereferenceable] = trackHandles_.read(
-    [&trackIdentifier](const auto& trackHandles)
-    {
-        auto iter = trackHandles.find(trackIdentifier);
-        return std::make_pair(iter, iter != trackHandles.end());
-    });
+    if (auto trackHandle = find_track_handle(trackIdentifier)) [[likely]]
+        return trackHandle;
 
-    if (!isDereferenceable)
+    return tracks_.write(
+    trackIdentifier.hash(),
+    [&](auto& tracks) -> std::variant<std::shared_ptr<TrackHandle>, WaitSignal>
     {
-        return trackWaitSignals_.write(
-        [&trackIdentifier](auto& trackWaitSignals)
-        {
-            auto [iter, success] =
-            trackWaitSignals.try_emplace(trackIdentifier,
-                                         std::make_shared<std::atomic<WaitStatus>>(
-                                         WaitStatus::Wait));
+        TrackEntry& trackEntry = tracks[trackIdentifier];
+        // the track might have been added since we looked it up
+        if (trackEntry.trackHandle_)
+            return trackEntry.trackHandle_;
 
-            return iter->second;
-        });
-    }
-    return trackHandleIter->second;
+        if (!trackEntry.pendingNotifier_)
+            trackEntry.pendingNotifier_ = std::make_unique<EpochNotifier>();
+        return WaitSignal(*trackEntry.pendingNotifier_);
+    });
 }
 
 PublisherPriority
 DataManager::get_track_publisher_priority(const TrackIdentifier& trackIdentifier)
 {
-    auto [trackHandleIter, isDereferenceable] = trackHandles_.read(
-    [&trackIdentifier](const auto& trackHandles)
-    {
-        auto iter = trackHandles.find(trackIdentifier);
-        return std::make_pair(iter, iter != trackHandles.end());
-    });
-
-    if (isDereferenceable)
-        return trackHandleIter->second->publisherPriority_;
+    if (auto trackHandle = find_track_handle(trackIdentifier))
+        return trackHandle->publisherPriority_;
     else
     {
         exit(1);
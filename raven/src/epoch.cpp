@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <epoch.hpp>
+#include <limits>
+#include <utility>
+
+namespace rvn
+{
+namespace
+{
+    // hands the records of this thread back to their domains on thread exit
+    struct ThreadRecords
+    {
+        std::vector<std::pair<const EpochDomain*, EpochDomain::ThreadRecord*>> records_;
+
+        ~ThreadRecords()
+        {
+            for (auto& [domain, record] : records_)
+                record->inUse_.store(false, std::memory_order_release);
+        }
+    };
+
+    thread_local ThreadRecords threadRecords;
+} // namespace
+
+EpochDomain::ThreadRecord* EpochDomain::thread_record()
+{
+    for (auto& [domain, record] : threadRecords.records_)
+        if (domain == this) [[likely]]
+            return record;
+
+    ThreadRecord* record = acquire_record();
+    threadRecords.records_.emplace_back(this, record);
+    return record;
+}
+
+EpochDomain::ThreadRecord* EpochDomain::acquire_record()
+{
+    // reuse record of an exited thread if possible
+    for (ThreadRecord* record = records_.load(std::memory_order_acquire);
+         record != nullptr; record = record->next_)
+    {
+        bool expected = false;
+        if (!record->inUse_.load(std::memory_order_relaxed) &&
+            record->inUse_.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            return record;
+    }
+
+    ThreadRecord* record = new ThreadRecord();
+    record->inUse_.store(true, std::memory_order_relaxed);
+
+    ThreadRecord* head = records_.load(std::memory_order_relaxed);
+    do
+    {
+        record->next_ = head;
+    } while (!records_.compare_exchange_weak(head, record, std::memory_order_release,
+                                             std::memory_order_relaxed));
+    return record;
+}
+
+std::uint64_t EpochDomain::min_pinned_epoch() const noexcept
+{
+    std::uint64_t minEpoch = std::numeric_limits<std::uint64_t>::max();
+    for (ThreadRecord* record = records_.load(std::memory_order_acquire);
+         record != nullptr; record = record->next_)
+    {
+        std::uint64_t epoch = record->epoch_.load(std::memory_order_acquire);
+        if (epoch != 0)
+            minEpoch = std::min(minEpoch, epoch);
+    }
+    return minEpoch;
+}
+
+void EpochDomain::retire(void* ptr, void (*deleter)(void*))
+{
+    // readers pinning after this point announce an epoch > retireEpoch
+    std::uint64_t retireEpoch = globalEpoch_.fetch_add(1, std::memory_order_acq_rel);
+
+    bool shouldReclaim;
+    {
+        std::unique_lock l(retiredMtx_);
+        retired_.push_back(Retired{ retireEpoch, ptr, deleter });
+        shouldReclaim = retired_.size() % reclaimThreshold == 0;
+    }
+
+    if (shouldReclaim)
+        reclaim();
+}
+
+void EpochDomain::reclaim()
+{
+    // pairs with the fence in Guard, either the reader announced its epoch
+    // or it can not observe the nodes unlinked before retire
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::uint64_t minPinnedEpoch = min_pinned_epoch();
+
+    std::vector<Retired> freeable;
+    {
+        std::unique_lock l(retiredMtx_);
+        auto iter = std::partition(retired_.begin(), retired_.end(),
+                                   [minPinnedEpoch](const Retired& retired)
+                                   { return retired.epoch_ >= minPinnedEpoch; });
+        freeable.assign(iter, retired_.end());
+        retired_.erase(iter, retired_.end());
+    }
+
+    // deleters may retire nodes themselves
+    for (auto& retired : freeable)
+        retired.deleter_(retired.ptr_);
+}
+
+void EpochDomain::retire_deferred(void* ptr, void (*deleter)(void*))
+{
+    std::uint64_t retireEpoch = globalEpoch_.fetch_add(1, std::memory_order_acq_rel);
+
+    std::unique_lock l(retiredMtx_);
+    deferred_.push_back(Retired{ retireEpoch, ptr, deleter });
+    numDeferred_.store(deferred_.size(), std::memory_order_release);
+}
+
+bool EpochDomain::reclaim_deferred()
+{
+    // retires coalesce into one run, often an earlier run took them all
+    if (numDeferred_.load(std::memory_order_acquire) == 0)
+        return true;
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::uint64_t minPinnedEpoch = min_pinned_epoch();
+
+    std::vector<Retired> freeable;
+    bool isDrained;
+    {
+        std::unique_lock l(retiredMtx_);
+        auto iter = std::partition(deferred_.begin(), deferred_.end(),
+                                   [minPinnedEpoch](const Retired& retired)
+                                   { return retired.epoch_ >= minPinnedEpoch; });
+        freeable.assign(iter, deferred_.end());
+        deferred_.erase(iter, deferred_.end());
+        numDeferred_.store(deferred_.size(), std::memory_order_release);
+        isDrained = deferred_.empty();
+    }
+
+    for (auto& retired : freeable)
+        retired.deleter_(retired.ptr_);
+
+    return isDrained;
+}
+
+EpochDomain::~EpochDomain()
+{
+    for (auto& retired : retired_)
+        retired.deleter_(retired.ptr_);
+    for (auto& retired : deferred_)
+        retired.deleter_(retired.ptr_);
+
+    ThreadRecord* record = records_.load(std::memory_order_relaxed);
+    while (record != nullptr)
+        delete std::exchange(record, record->next_);
+}
+} // namespace rvn
@@ -86,4 +86,20 @@ void MessageHandler::operator()(StreamHeaderSubgroupMessage streamHeaderSubgroup
       dataStreamState.streamHeaderSubgroupMessage_, dataStreamState.objectQueue_ });
 }
 
+void MessageHandler::operator()(ObjectDatagramMessage objectDatagramMessage)
+{
+    MOQTClient& moqtClient =
+    static_cast<MOQTClient&>(streamState_.connectionState_.moqtObject_);
+
+    // datagrams are not sent on a subgroup, they are reported as subgroup 0
+    const ObjectDatagramHeader& header = objectDatagramMessage.header_;
+    auto streamHeaderSubgroupMessage = std::make_shared<StreamHeaderSubgroupMessage>(
+    StreamHeaderSubgroupMessage{ header.trackAlias_, header.groupId_, SubGroupId(0),
+                                 header.publisherPriority_ });
+
+    moqtClient.receivedObjects_.enqueue(
+    { std::move(streamHeaderSubgroupMessage),
+      StreamHeaderSubgroupObject{ header.objectId_.get(), std::move(objectDatagramMessage.payload_) } });
+}
+
 } // namespace rvn
@@ -40,7 +40,8 @@ void MOQTClient::start_connection(QUIC_ADDRESS_FAMILY Family, const char* Server
                            { configuration.get(), Family, ServerName, ServerPort });
 
     // connection state is optional
-    connectionState = std::make_shared<ConnectionState>(std::move(connection), *this);
+    connectionState = ConnectionState::create(std::move(connection), *this,
+                                              ConnectionState::Destruction::Direct);
 
     quicConnectionStateSetupFlag_.store(true, std::memory_order_release);
 
@@ -1,9 +1,12 @@
 #include "subscription_manager.hpp"
 #include <contexts.hpp>
+#include <epoch.hpp>
 #include <moqt.hpp>
 #include <utilities.hpp>
 #include <wrappers.hpp>
 
+#include <thread>
+
 namespace rvn
 {
 
@@ -19,6 +22,20 @@ MOQTServer::MOQTServer(std::shared_ptr<DataManager> dataManager,
         throw std::runtime_error("Could not set execution config");
 };
 
+MOQTServer::~MOQTServer()
+{
+    {
+        std::unique_lock l(connectionStateMapMtx);
+        connectionStateMap.clear();
+    }
+    // joins the subscription threads, nothing is pinned afterwards
+    subscriptionManager_.reset();
+    // no connection outlives the server, whether or not the timer thread
+    // got to it already
+    while (!EpochDomainHandle()->reclaim_deferred())
+        std::this_thread::yield();
+}
+
 void MOQTServer::start_listener(QUIC_ADDR* LocalAddress)
 {
     rvn::utils::ASSERT_LOG_THROW(secondaryCounter == full_sec_counter_value(),
@@ -0,0 +1,398 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <segment_log.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tuple>
+#include <unistd.h>
+#include <utilities.hpp>
+
+namespace rvn
+{
+namespace
+{
+    constexpr std::uint64_t minFileSize = 1ull << 16;
+
+    std::uint64_t align_record(std::uint64_t size) noexcept
+    {
+        return (size + 7) & ~std::uint64_t(7);
+    }
+
+    std::uint64_t align_page(std::uint64_t size) noexcept
+    {
+        static const std::uint64_t pageSize = sysconf(_SC_PAGESIZE);
+        return (size + pageSize - 1) / pageSize * pageSize;
+    }
+
+    std::filesystem::path segment_path(const std::filesystem::path& directory, std::uint64_t sequence)
+    {
+        return directory / (std::to_string(sequence) + ".seg");
+    }
+} // namespace
+
+SegmentLog::SegmentLog(std::filesystem::path directory, SegmentLogOptions options)
+: directory_(std::move(directory)), options_(options)
+{
+    std::filesystem::create_directories(directory_);
+
+    std::vector<std::uint64_t> sequences;
+    for (const auto& dirEntry : std::filesystem::directory_iterator(directory_))
+    {
+        if (!dirEntry.is_regular_file() || dirEntry.path().extension() != ".seg")
+            continue;
+
+        std::string stem = dirEntry.path().stem().string();
+        if (stem.empty() ||
+            !std::all_of(stem.begin(), stem.end(), [](unsigned char c) { return std::isdigit(c); }))
+            continue;
+        sequences.push_back(std::stoull(stem));
+    }
+    std::sort(sequences.begin(), sequences.end());
+
+    for (std::uint64_t i = 0; i < sequences.size(); i++)
+        open_segment(sequences[i], i + 1 == sequences.size());
+}
+
+SegmentLog::~SegmentLog()
+{
+    seal_active_segment();
+    for (auto& segment : segments_)
+        if (segment.data_ != nullptr)
+            munmap(segment.data_, segment.mappedBytes_);
+}
+
+void SegmentLog::open_segment(std::uint64_t sequence, bool isActive)
+{
+    Segment& segment = segments_.emplace_back();
+    segment.sequence_ = sequence;
+
+    std::filesystem::path path = segment_path(directory_, sequence);
+    segment.fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    utils::ASSERT_LOG_THROW(segment.fd_ != -1, "Failed to open segment", path,
+                            std::strerror(errno));
+
+    struct stat st;
+    utils::ASSERT_LOG_THROW(fstat(segment.fd_, &st) == 0, "Failed to stat segment", path);
+    segment.fileSize_ = st.st_size;
+    utils::ASSERT_LOG_THROW(segment.fileSize_ <= options_.maxSegmentBytes_,
+                            "Segment larger than maxSegmentBytes", path);
+
+    // the whole active segment is reserved up front so that the mapping
+    // never moves, sealed segments are only read
+    segment.mappedBytes_ = isActive ? options_.maxSegmentBytes_ : align_page(segment.fileSize_);
+    if (segment.mappedBytes_ != 0)
+    {
+        void* data = mmap(nullptr, segment.mappedBytes_,
+                          isActive ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+                          segment.fd_, 0);
+        utils::ASSERT_LOG_THROW(data != MAP_FAILED, "Failed to map segment", path,
+                                std::strerror(errno));
+        segment.data_ = static_cast<std::uint8_t*>(data);
+    }
+
+    segment.firstRecordIdx_ = recordsOffset_ + records_.size();
+    index_segment(segment);
+    segment.numRecords_ = recordsOffset_ + records_.size() - segment.firstRecordIdx_;
+
+    if (isActive)
+    {
+        // drop a torn record at the tail
+        if (segment.fileSize_ > segment.writeOffset_)
+        {
+            utils::ASSERT_LOG_THROW(ftruncate(segment.fd_, segment.writeOffset_) == 0,
+                                    "Failed to truncate segment", path);
+            segment.fileSize_ = segment.writeOffset_;
+        }
+    }
+    else
+    {
+        close(segment.fd_);
+        segment.fd_ = -1;
+    }
+}
+
+void SegmentLog::index_segment(Segment& segment)
+{
+    std::uint64_t offset = 0;
+    while (offset + sizeof(RecordHeader) <= segment.fileSize_)
+    {
+        RecordHeader header;
+        std::memcpy(&header, segment.data_ + offset, sizeof(RecordHeader));
+
+        std::uint64_t recordSize = align_record(sizeof(RecordHeader) + header.length_);
+        if (header.magic_ != recordMagic || offset + recordSize > segment.fileSize_ ||
+            header.kind_ > static_cast<std::uint8_t>(RecordKind::TrackTerminator))
+            break;
+
+        if (segment.lastGroupId_ != GroupId(header.groupId_))
+        {
+            segment.numGroups_++;
+            segment.lastGroupId_ = GroupId(header.groupId_);
+        }
+
+        QUIC_BUFFER payload{ header.length_, segment.data_ + offset + sizeof(RecordHeader) };
+        index_record(GroupId(header.groupId_), ObjectId(header.objectId_),
+                     static_cast<RecordKind>(header.kind_), payload);
+        offset += recordSize;
+    }
+    segment.writeOffset_ = offset;
+}
+
+void SegmentLog::index_record(GroupId groupId, ObjectId objectId, RecordKind kind, QUIC_BUFFER payload)
+{
+    std::unique_lock l(mtx_);
+
+    auto key = std::make_tuple(groupId, objectId);
+    auto iter = index_.end();
+    // appends are almost always in order
+    if (!index_.empty() && !(std::make_tuple(index_.back().groupId_, index_.back().objectId_) < key))
+        iter = std::lower_bound(index_.begin(), index_.end(), key,
+                                [](const IndexEntry& entry, const auto& key)
+                                { return std::make_tuple(entry.groupId_, entry.objectId_) < key; });
+
+    index_.insert(iter, IndexEntry{ groupId, objectId, recordsOffset_ + records_.size() });
+    records_.emplace_back(payload, kind);
+}
+
+void SegmentLog::seal_active_segment()
+{
+    if (segments_.empty() || segments_.back().fd_ == -1)
+        return;
+
+    Segment& segment = segments_.back();
+    // the file was grown in steps, cut it down to the records
+    if (ftruncate(segment.fd_, segment.writeOffset_) != 0)
+        LOGE("Failed to truncate segment", segment_path(directory_, segment.sequence_));
+    msync(segment.data_, segment.writeOffset_, MS_ASYNC);
+    close(segment.fd_);
+    segment.fd_ = -1;
+
+    // give back the reservation past the records, borrowed payloads keep
+    // their addresses
+    std::uint64_t mappedBytes = align_page(segment.writeOffset_);
+    if (mappedBytes < segment.mappedBytes_)
+        munmap(segment.data_ + mappedBytes, segment.mappedBytes_ - mappedBytes);
+    if (mappedBytes == 0)
+        segment.data_ = nullptr;
+    else
+        mprotect(segment.data_, mappedBytes, PROT_READ);
+    segment.mappedBytes_ = mappedBytes;
+}
+
+void SegmentLog::roll_segment()
+{
+    std::uint64_t sequence = segments_.empty() ? 0 : segments_.back().sequence_ + 1;
+    seal_active_segment();
+    open_segment(sequence, true);
+    enforce_max_segments();
+    release_dropped_segments();
+}
+
+void SegmentLog::enforce_max_segments()
+{
+    if (!options_.maxSegments_.has_value())
+        return;
+
+    // the active segment is never dropped
+    std::uint64_t maxSegments = std::max<std::uint64_t>(*options_.maxSegments_, 1);
+    std::uint64_t numSegments =
+    std::count_if(segments_.begin(), segments_.end(),
+                  [](const Segment& segment) { return !segment.dropped_; });
+
+    for (auto& segment : segments_)
+    {
+        if (numSegments <= maxSegments)
+            break;
+        if (segment.dropped_)
+            continue;
+
+        std::error_code errorCode;
+        std::filesystem::remove(segment_path(directory_, segment.sequence_), errorCode);
+        if (errorCode)
+            LOGE("Failed to remove segment", segment_path(directory_, segment.sequence_),
+                 errorCode.message());
+
+        {
+            std::unique_lock l(mtx_);
+            std::erase_if(index_,
+                          [&segment](const IndexEntry& entry)
+                          {
+                              return entry.recordIdx_ >= segment.firstRecordIdx_ &&
+                                     entry.recordIdx_ < segment.firstRecordIdx_ + segment.numRecords_;
+                          });
+        }
+        segment.dropped_ = true;
+        numSegments--;
+    }
+}
+
+void SegmentLog::release_dropped_segments()
+{
+    // records of older segments are at the front of records_
+    while (!segments_.empty() && segments_.front().dropped_)
+    {
+        Segment& segment = segments_.front();
+
+        // readers only borrow through the index, once a segment is dropped
+        // the counts can only go down, checked again on the next roll
+        bool isBorrowed = std::any_of(records_.begin(), records_.begin() + segment.numRecords_,
+                                      [](const ColdRecord& record)
+                                      {
+                                          return record.payload_.refCount_.load(
+                                                 std::memory_order_acquire) !=
+                                                 SharedQuicBuffer::borrowedRefCount;
+                                      });
+        if (isBorrowed)
+            break;
+
+        if (segment.data_ != nullptr)
+            munmap(segment.data_, segment.mappedBytes_);
+
+        {
+            std::unique_lock l(mtx_);
+            for (std::uint64_t i = 0; i < segment.numRecords_; i++)
+                records_.pop_front();
+            recordsOffset_ += segment.numRecords_;
+        }
+        segments_.pop_front();
+    }
+}
+
+bool SegmentLog::append(GroupId groupId, ObjectId objectId, RecordKind kind, const QUIC_BUFFER* payload)
+{
+    // the writer is the only one modifying the index, no need to lock
+    if (find(groupId, objectId) != index_.end())
+        return false;
+
+    std::uint32_t length = payload != nullptr ? payload->Length : 0;
+    std::uint64_t recordSize = align_record(sizeof(RecordHeader) + length);
+    utils::ASSERT_LOG_THROW(recordSize <= options_.maxSegmentBytes_,
+                            "Object larger than maxSegmentBytes", recordSize);
+
+    bool startsGroup = segments_.empty() || segments_.back().lastGroupId_ != groupId;
+    if (segments_.empty() || segments_.back().fd_ == -1 ||
+        (startsGroup && segments_.back().numGroups_ >= options_.groupsPerSegment_) ||
+        segments_.back().writeOffset_ + recordSize > options_.maxSegmentBytes_)
+        roll_segment();
+
+    Segment& segment = segments_.back();
+    if (segment.writeOffset_ + recordSize > segment.fileSize_)
+    {
+        std::uint64_t fileSize =
+        std::max({ segment.fileSize_ * 2, segment.writeOffset_ + recordSize, minFileSize });
+        fileSize = std::min(fileSize, options_.maxSegmentBytes_);
+        utils::ASSERT_LOG_THROW(ftruncate(segment.fd_, fileSize) == 0, "Failed to grow segment",
+                                segment_path(directory_, segment.sequence_),
+                                std::strerror(errno));
+        segment.fileSize_ = fileSize;
+    }
+
+    std::uint8_t* record = segment.data_ + segment.writeOffset_;
+    if (length != 0)
+        std::memcpy(record + sizeof(RecordHeader), payload->Buffer, length);
+
+    RecordHeader header{};
+    header.length_ = length;
+    header.groupId_ = groupId;
+    header.objectId_ = objectId;
+    header.kind_ = static_cast<std::uint8_t>(kind);
+    std::memcpy(record, &header, sizeof(RecordHeader));
+    // magic is written last, a record torn by a crash is not indexed on reopen
+    std::memcpy(record, &recordMagic, sizeof(recordMagic));
+
+    if (startsGroup)
+    {
+        segment.numGroups_++;
+        segment.lastGroupId_ = groupId;
+    }
+    segment.writeOffset_ += recordSize;
+    segment.numRecords_++;
+
+    index_record(groupId, objectId, kind, QUIC_BUFFER{ length, record + sizeof(RecordHeader) });
+    return true;
+}
+
+std::vector<SegmentLog::IndexEntry>::const_iterator
+SegmentLog::find(GroupId groupId, ObjectId objectId) const
+{
+    auto key = std::make_tuple(groupId, objectId);
+    auto iter = std::lower_bound(index_.begin(), index_.end(), key,
+                                 [](const IndexEntry& entry, const auto& key)
+                                 { return std::make_tuple(entry.groupId_, entry.objectId_) < key; });
+    if (iter != index_.end() && iter->groupId_ == groupId && iter->objectId_ == objectId)
+        return iter;
+    return index_.end();
+}
+
+SegmentLog::Record SegmentLog::make_record(const IndexEntry& entry) const
+{
+    ColdRecord& record = records_[entry.recordIdx_ - recordsOffset_];
+    SharedQuicBuffer payload;
+    if (record.kind_ == RecordKind::Payload)
+        payload = SharedQuicBuffer::borrow(record.payload_);
+    return Record{ entry.groupId_, entry.objectId_, record.kind_, std::move(payload) };
+}
+
+std::optional<SegmentLog::Record> SegmentLog::first() const
+{
+    std::shared_lock l(mtx_);
+    if (index_.empty())
+        return std::nullopt;
+    return make_record(index_.front());
+}
+
+std::optional<SegmentLog::Record> SegmentLog::next(GroupId groupId, ObjectId objectId) const
+{
+    std::shared_lock l(mtx_);
+    auto key = std::make_tuple(groupId, objectId);
+    auto iter = std::upper_bound(index_.begin(), index_.end(), key,
+                                 [](const auto& key, const IndexEntry& entry)
+                                 { return key < std::make_tuple(entry.groupId_, entry.objectId_); });
+    if (iter == index_.end())
+        return std::nullopt;
+    return make_record(*iter);
+}
+
+std::optional<SegmentLog::Record> SegmentLog::lower_bound(GroupId groupId, ObjectId objectId) const
+{
+    std::shared_lock l(mtx_);
+    auto key = std::make_tuple(groupId, objectId);
+    auto iter = std::lower_bound(index_.begin(), index_.end(), key,
+                                 [](const IndexEntry& entry, const auto& key)
+                                 { return std::make_tuple(entry.groupId_, entry.objectId_) < key; });
+    if (iter == index_.end())
+        return std::nullopt;
+    return make_record(*iter);
+}
+
+std::optional<GroupId> SegmentLog::latest_group_id() const
+{
+    std::shared_lock l(mtx_);
+    if (index_.empty())
+        return std::nullopt;
+    return index_.back().groupId_;
+}
+
+std::vector<SegmentLog::Record> SegmentLog::group_records(GroupId groupId) const
+{
+    std::shared_lock l(mtx_);
+    std::vector<Record> records;
+
+    auto iter = std::lower_bound(index_.begin(), index_.end(), groupId,
+                                 [](const IndexEntry& entry, GroupId groupId)
+                                 { return entry.groupId_ < groupId; });
+    for (; iter != index_.end() && iter->groupId_ == groupId; ++iter)
+        records.push_back(make_record(*iter));
+    return records;
+}
+
+std::uint64_t SegmentLog::size() const
+{
+    std::shared_lock l(mtx_);
+    return index_.size();
+}
+} // namespace rvn
@@ -0,0 +1,101 @@
+#include <iterator>
+#include <send_scheduler.hpp>
+#include <utilities.hpp>
+
+namespace rvn
+{
+void SendScheduler::push(ScheduledObject scheduledObject, bool supersede)
+{
+    FlowKey flowKey{ scheduledObject.objectIdentifier_.track_id().get(),
+                     scheduledObject.subscriberPriority_.get() };
+
+    auto [flowIter, isNewFlow] = flows_.try_emplace(flowKey);
+    Flow& flow = flowIter->second;
+    if (isNewFlow)
+    {
+        std::uint16_t rank = static_cast<std::uint16_t>(
+        scheduledObject.subscriberPriority_.get() << 8 | scheduledObject.publisherPriority_.get());
+        ranks_[rank].push_back(flowKey);
+    }
+    flow.groupOrder_ = scheduledObject.groupOrder_;
+
+    GroupId groupId = scheduledObject.objectIdentifier_.groupId_;
+    if (supersede)
+    {
+        auto first = flow.objects_.lower_bound({ groupId, ObjectId(0) });
+        auto last = first;
+        for (; last != flow.objects_.end() && std::get<0>(last->first) == groupId; ++last)
+            numBytes_ -= payload_length(last->second);
+        size_ -= std::distance(first, last);
+        flow.objects_.erase(first, last);
+    }
+
+    auto key = std::make_tuple(groupId, scheduledObject.objectIdentifier_.objectId_);
+    numBytes_ += payload_length(scheduledObject);
+    auto [objectIter, isNewObject] = flow.objects_.try_emplace(key, std::move(scheduledObject));
+    if (isNewObject)
+        size_++;
+    else
+    {
+        // scheduled twice, the newer copy wins
+        numBytes_ -= payload_length(objectIter->second);
+        objectIter->second = std::move(scheduledObject);
+    }
+}
+
+ScheduledObject SendScheduler::pop()
+{
+    std::vector<ScheduledObject> run;
+    pop_run(run, 1, 0);
+    return std::move(run.front());
+}
+
+void SendScheduler::pop_run(std::vector<ScheduledObject>& run, std::size_t maxObjects, std::uint64_t maxBytes)
+{
+    utils::ASSERT_LOG_THROW(!empty(), "pop on empty SendScheduler");
+
+    auto rankIter = ranks_.begin();
+    auto& turns = rankIter->second;
+    FlowKey flowKey = turns.front();
+    turns.pop_front();
+
+    auto flowIter = flows_.find(flowKey);
+    Flow& flow = flowIter->second;
+
+    auto objectIter = flow.objects_.begin();
+    if (flow.groupOrder_ == GroupOrder::Descending)
+    {
+        // first object of the newest group
+        GroupId newestGroupId = std::get<0>(std::prev(flow.objects_.end())->first);
+        objectIter = flow.objects_.lower_bound({ newestGroupId, ObjectId(0) });
+    }
+
+    GroupId groupId = std::get<0>(objectIter->first);
+    bool datagram = objectIter->second.datagram_;
+    std::uint64_t runBytes = 0;
+    for (std::size_t numPopped = 0; numPopped < maxObjects; numPopped++)
+    {
+        if (objectIter == flow.objects_.end() || std::get<0>(objectIter->first) != groupId ||
+            objectIter->second.datagram_ != datagram)
+            break;
+
+        std::uint64_t numBytes = payload_length(objectIter->second);
+        if (numPopped != 0 && runBytes + numBytes > maxBytes)
+            break;
+
+        run.push_back(std::move(objectIter->second));
+        objectIter = flow.objects_.erase(objectIter);
+        runBytes += numBytes;
+        numBytes_ -= numBytes;
+        size_--;
+    }
+
+    // the flow goes to the back of its rank, other flows of the rank go first
+    if (flow.objects_.empty())
+        flows_.erase(flowIter);
+    else
+        turns.push_back(flowKey);
+    if (turns.empty())
+        ranks_.erase(rankIter);
+}
+} // namespace rvn
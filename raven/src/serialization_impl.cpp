@@ -1,6 +1,7 @@
 #include "serialization/chunk.hpp"
 #include "serialization/messages.hpp"
 #include "serialization/quic_var_int.hpp"
+#include <bit>
 #include <serialization/serialization_impl.hpp>
 #include <utilities.hpp>
 
@@ -37,6 +38,33 @@ serialize_return_t serialize(ds::chunk& c, const rvn::DeliveryTimeoutParameter&
     parameterTotalLen += serialize<ds::quic_var_int>(c, parameter.timeout_.count());
     return parameterTotalLen;
 }
+[[nodiscard]] serialize_return_t
+mock_serialize(const rvn::ObjectDeliveryParameter& parameter)
+{
+    std::uint64_t parameterTotalLen = 0;
+    parameterTotalLen += mock_serialize<ds::quic_var_int>(
+    utils::to_underlying(ParameterType::ObjectDelivery));
+    std::uint64_t parameterLength =
+    ds::quic_var_int(utils::to_underlying(parameter.delivery_)).size();
+    parameterTotalLen += mock_serialize<ds::quic_var_int>(parameterLength);
+    parameterTotalLen +=
+    mock_serialize<ds::quic_var_int>(utils::to_underlying(parameter.delivery_));
+    return parameterTotalLen;
+}
+
+serialize_return_t serialize(ds::chunk& c, const rvn::ObjectDeliveryParameter& parameter)
+{
+    std::uint64_t parameterTotalLen = 0;
+    parameterTotalLen +=
+    serialize<ds::quic_var_int>(c, utils::to_underlying(ParameterType::ObjectDelivery));
+    std::uint64_t parameterLength =
+    ds::quic_var_int(utils::to_underlying(parameter.delivery_)).size();
+    parameterTotalLen += serialize<ds::quic_var_int>(c, parameterLength);
+    parameterTotalLen +=
+    serialize<ds::quic_var_int>(c, utils::to_underlying(parameter.delivery_));
+    return parameterTotalLen;
+}
+
 serialize_return_t serialize(ds::chunk& c, const rvn::Parameter& parameter)
 {
     return std::visit([&c](const auto& param) { return serialize(c, param); },
@@ -236,6 +264,66 @@ serialize_return_t serialize(ds::chunk& c, const StreamHeaderSubgroupObject& msg
     return msgLen;
 }
 
+serialize_return_t serialize(ds::chunk& c, const ObjectDatagramHeader& msg)
+{
+    std::uint64_t msgLen = 0;
+
+    // header
+    msgLen += serialize<ds::quic_var_int>(c, utils::to_underlying(msg.id_));
+
+    // body
+    msgLen += serialize<ds::quic_var_int>(c, msg.trackAlias_.get());
+    msgLen += serialize<ds::quic_var_int>(c, msg.groupId_.get());
+    msgLen += serialize<ds::quic_var_int>(c, msg.objectId_.get());
+    msgLen += serialize<std::uint8_t>(c, msg.publisherPriority_);
+
+    return msgLen;
+}
+
+// network order with the length in the top two bits, like serialize<ds::quic_var_int>
+static serialize_return_t write_quic_var_int(std::uint8_t* bytes, ds::quic_var_int i)
+{
+    std::uint8_t size = i.size();
+    std::uint64_t value = i.get();
+    for (std::uint8_t index = size; index-- > 0;)
+    {
+        bytes[index] = value & 0xff;
+        value >>= 8;
+    }
+    bytes[0] |= std::countr_zero(size) << 6;
+
+    return size;
+}
+
+serialize_return_t
+serialize(std::span<std::uint8_t, ObjectDatagramHeader::maxSerializedLength> bytes,
+          const ObjectDatagramHeader& msg)
+{
+    std::uint64_t msgLen = 0;
+
+    // header
+    msgLen += write_quic_var_int(bytes.data() + msgLen, utils::to_underlying(msg.id_));
+
+    // body
+    msgLen += write_quic_var_int(bytes.data() + msgLen, msg.trackAlias_.get());
+    msgLen += write_quic_var_int(bytes.data() + msgLen, msg.groupId_.get());
+    msgLen += write_quic_var_int(bytes.data() + msgLen, msg.objectId_.get());
+    bytes[msgLen++] = msg.publisherPriority_.get();
+
+    return msgLen;
+}
+
+serialize_return_t serialize(ds::chunk& c, const ObjectDatagramMessage& msg)
+{
+    std::uint64_t msgLen = serialize(c, msg.header_);
+
+    msgLen += serialize<ds::quic_var_int>(c, msg.payload_.size());
+    c.append(msg.payload_.data(), msg.payload_.size());
+    msgLen += msg.payload_.size();
+
+    return msgLen;
+}
+
 serialize_return_t
 serialize(ds::chunk& c, const rvn::SubscribeErrorMessage& subscribeErrorMessage)
 {
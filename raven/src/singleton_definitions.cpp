@@ -1,6 +1,11 @@
+#include <data_manager.hpp>
+#include <epoch.hpp>
 #include <timer_wheel.hpp>
 
 namespace rvn
 {
 Timer* TimerHandle::instance = nullptr;
+// created eagerly, readers on any thread pin it concurrently
+EpochDomain* EpochDomainHandle::instance = new EpochDomain();
+TrackIdentifierRegistry* TrackIdentifierRegistryHandle::instance = new TrackIdentifierRegistry();
 } // namespace rvn
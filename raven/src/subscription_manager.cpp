@@ -1,11 +1,14 @@
 /////////////////////////////////////////////
 #include "strong_types.hpp"
+#include <algorithm>
 #include <atomic>
 #include <bit>
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <functional>
 #include <optional>
+#include <thread>
 #include <unistd.h>
 #include <variant>
 /////////////////////////////////////////////
@@ -24,18 +27,27 @@ namespace rvn
 
 MinorSubscriptionState::MinorSubscriptionState(SubscriptionState& subscriptionState,
                                                NextOperation nextOperation,
+                                               std::optional<ObjectIdentifier> startObject,
                                                std::optional<ObjectIdentifier> lastObjectToBeSent,
                                                PublisherPriority trackPublisherPriority,
                                                std::optional<std::chrono::milliseconds> deliveryTimeout)
 : subscriptionState_(std::addressof(subscriptionState)),
-  nextOperation_(nextOperation), lastObjectToBeSent_(std::move(lastObjectToBeSent)),
+  nextOperation_(nextOperation), startObject_(std::move(startObject)),
+  lastObjectToBeSent_(std::move(lastObjectToBeSent)),
   trackPublisherPriority_(trackPublisherPriority),
+  subscriberPriority_(subscriptionState.subscriptionMessage_.subscriberPriority_),
+  // tracks do not carry a preferred group order, publishers go oldest first
+  groupOrder_(static_cast<GroupOrder>(subscriptionState.subscriptionMessage_.groupOrder_)),
   mustBeSent_(std::countl_zero(trackPublisherPriority_.get()) == 0), // MSB is 1
+  datagram_(subscriptionState.subscriptionMessage_.get_parameter<ObjectDeliveryParameter>() ==
+            ObjectDeliveryParameter{ ObjectDelivery::Datagram }),
   subscribeDeliveryTimeout_(deliveryTimeout)
 {
+    if (groupOrder_ == GroupOrder::Publisher)
+        groupOrder_ = GroupOrder::Ascending;
 }
 
-bool MinorSubscriptionState::is_waiting_for_object()
+bool MinorSubscriptionState::is_waiting_for_object() const noexcept
 {
     if (!waitSignal_.has_value()) [[unlikely]]
         // not waiting on object to be ready
@@ -43,7 +55,7 @@ bool MinorSubscriptionState::is_waiting_for_object()
 
     // we wait on the flag, only is flag is ready, we do acquire operation
     // might have performance benefits on weaker memory models (ARM, POWERPC...)
-    return (*waitSignal_)->load(std::memory_order_relaxed) == WaitStatus::Ready;
+    return waitSignal_->is_ready(std::memory_order_relaxed);
 
     // We only return that it is true, we have to reset the flag in the
     // fulfill_some_minor function and also have an acquire load on the flag
@@ -51,103 +63,202 @@ bool MinorSubscriptionState::is_waiting_for_object()
 
 // returns true if fulfilling is done
 // called only when wait signal is set, wait signal never gets unset once set
-FulfillSomeReturn MinorSubscriptionState::fulfill_some_minor()
+FulfillSomeReturn
+MinorSubscriptionState::fulfill_some_minor(FanoutCache& fanoutCache, ConnectionsToFlush& connectionsToFlush)
 {
     if (waitSignal_.has_value()) [[likely]]
     {
         // we have to reset the flag
-        (*waitSignal_)->load(std::memory_order_acquire);
+        waitSignal_->is_ready(std::memory_order_acquire);
         waitSignal_.reset();
     }
 
-    auto connectionStateSharedPtr = subscriptionState_->connectionStateWeakPtr_.lock();
-    if (!connectionStateSharedPtr)
+    // the owning thread pinned the EpochDomain for the round, a connection
+    // which has not expired now outlives the round
+    if (subscriptionState_->connection_expired())
         return SubscriptionStateErr::ConnectionExpired{};
+    ConnectionState& connectionState = *subscriptionState_->connectionState_;
 
-    // monostate required as we do not want to default construct shit
-    EnrichedObjectOrWait objectInfoOrWait;
-    switch (nextOperation_)
+    // objects which are already available (catching up on history) are sent
+    // in bursts instead of one per round
+    TrackHandle& trackHandle = *subscriptionState_->trackHandle_;
+    for (std::uint64_t numSent = 0; numSent < maxObjectsPerRound; numSent++)
     {
-        case NextOperation::First:
+        // objects stay in the store until the connection can take them,
+        // the wait signal is set once sends complete
+        if (auto budgetSignal = connectionState.wait_for_send_budget())
         {
-            objectInfoOrWait = subscriptionState_->trackHandle_->get_first_object();
-            if (!std::holds_alternative<WaitSignal>(objectInfoOrWait))
-                nextOperation_ = NextOperation::Next;
-            break;
+            waitSignal_ = std::move(*budgetSignal);
+            return false;
         }
-        case NextOperation::Next:
+
+        // monostate required as we do not want to default construct shit
+        EnrichedObjectOrWait objectInfoOrWait;
+        switch (nextOperation_)
         {
-            objectInfoOrWait =
-            subscriptionState_->trackHandle_->get_next_object(*previouslySentObject_);
-            break;
+            case NextOperation::First:
+            {
+                objectInfoOrWait =
+                fanoutCache.get(trackHandle, nextOperation_, std::nullopt,
+                                [&trackHandle]() { return trackHandle.get_first_object(); });
+                if (!std::holds_alternative<WaitSignal>(objectInfoOrWait))
+                    nextOperation_ = NextOperation::Next;
+                break;
+            }
+            case NextOperation::Seek:
+            {
+                objectInfoOrWait =
+                fanoutCache.get(trackHandle, nextOperation_, startObject_,
+                                [&]()
+                                {
+                                    return trackHandle.get_object_at_or_after(startObject_->groupId_,
+                                                                              startObject_->objectId_);
+                                });
+                if (!std::holds_alternative<WaitSignal>(objectInfoOrWait))
+                    nextOperation_ = NextOperation::Next;
+                break;
+            }
+            case NextOperation::Next:
+            {
+                objectInfoOrWait =
+                fanoutCache.get(trackHandle, nextOperation_, previouslySentObject_,
+                                [&]() { return trackHandle.get_next_object(*previouslySentObject_); });
+                break;
+            }
+            case NextOperation::Latest:
+            case NextOperation::LatestPerGroup:
+            {
+                // same lookup, shared between both
+                objectInfoOrWait =
+                fanoutCache.get(trackHandle, NextOperation::Latest, previouslySentObject_,
+                                [&]() { return trackHandle.get_latest_object(previouslySentObject_); });
+                break;
+            }
         }
-        case NextOperation::Latest:
+
+        if (std::holds_alternative<WaitSignal>(objectInfoOrWait))
         {
-            objectInfoOrWait =
-            subscriptionState_->trackHandle_->get_latest_object(previouslySentObject_);
-            break;
+            waitSignal_ = std::move(std::get<WaitSignal>(objectInfoOrWait));
+            return false;
         }
-    }
+        else
+        {
+            auto [groupId, objectId, object] =
+            std::get<EnrichedObjectType>(std::move(objectInfoOrWait));
 
+            if (object.is_track_terminator())
+            {
+                end_previous_group(connectionState, connectionsToFlush);
+                return true;
+            }
 
-    if (std::holds_alternative<WaitSignal>(objectInfoOrWait))
-    {
-        waitSignal_ = std::move(std::get<WaitSignal>(objectInfoOrWait));
-        return false;
-    }
-    else
-    {
-        auto [groupId, objectId, object] = std::get<EnrichedObjectType>(objectInfoOrWait);
+            if (lastObjectToBeSent_.has_value())
+            {
+                if (std::make_tuple(groupId, objectId) >
+                    std::make_tuple(lastObjectToBeSent_->groupId_,
+                                    lastObjectToBeSent_->objectId_))
+                {
+                    // we fulfilled the subscription requirement
+                    end_previous_group(connectionState, connectionsToFlush);
+                    return true;
+                }
+            }
 
-        if (object.is_track_terminator())
-            return true;
+            // the subscription is done with the group once it moves past it
+            bool leavesGroup =
+            previouslySentObject_.has_value() && previouslySentObject_->groupId_ != groupId;
+            if (leavesGroup)
+                end_previous_group(connectionState, connectionsToFlush);
 
-        if (lastObjectToBeSent_.has_value())
-        {
-            if (std::make_tuple(groupId, objectId) >
-                std::make_tuple(lastObjectToBeSent_->groupId_,
-                                lastObjectToBeSent_->objectId_))
+            // group terminators carry no payload, only the position moves
+            bool sendObject = !object.is_group_terminator();
+
+            // the object in flight is stale, abort it instead of letting it
+            // compete with the newer one for bandwidth
+            if (sendObject && nextOperation_ == NextOperation::LatestPerGroup &&
+                previouslySentObject_.has_value() && previouslySentObject_->groupId_ == groupId)
+                connectionState.abort_if_sending(*previouslySentObject_);
+
+            if (previouslySentObject_.has_value())
             {
-                // we fulfilled the subscription requirement
-                return true;
+                // we do not want to copy because copying track identifier is rather
+                // expensive operation (seq cst atomic add of shared_ptr)
+                previouslySentObject_->groupId_ = groupId;
+                previouslySentObject_->objectId_ = objectId;
+                if (leavesGroup)
+                    previousGroupEnded_ = false;
             }
-        }
+            else
+                previouslySentObject_ =
+                ObjectIdentifier{ subscriptionState_->trackHandle_->trackIdentifier_,
+                                  groupId, objectId };
 
-        if (previouslySentObject_.has_value())
-        {
-            // we do not want to copy because copying track identifier is rather
-            // expensive operation (seq cst atomic add of shared_ptr)
-            previouslySentObject_->groupId_ = groupId;
-            previouslySentObject_->objectId_ = objectId;
-        }
-        else
-            previouslySentObject_ =
-            ObjectIdentifier{ subscriptionState_->trackHandle_->trackIdentifier_,
-                              groupId, objectId };
+            if (!sendObject)
+            {
+                end_previous_group(connectionState, connectionsToFlush);
+                continue;
+            }
 
-        std::optional<std::chrono::milliseconds> timeoutDuration = subscribeDeliveryTimeout_;
+            std::optional<std::chrono::milliseconds> timeoutDuration = subscribeDeliveryTimeout_;
 
-        if (object.deliveryTimeout_)
-        {
-            if (timeoutDuration)
-                timeoutDuration = std::min(*timeoutDuration, *object.deliveryTimeout_);
-            else
-                timeoutDuration = object.deliveryTimeout_;
-        }
+            if (object.deliveryTimeout_)
+            {
+                if (timeoutDuration)
+                    timeoutDuration = std::min(*timeoutDuration, *object.deliveryTimeout_);
+                else
+                    timeoutDuration = object.deliveryTimeout_;
+            }
 
-        QUIC_STATUS status =
-        connectionStateSharedPtr->send_object(*previouslySentObject_, object.payload_,
-                                              trackPublisherPriority_, timeoutDuration);
-        if (QUIC_FAILED(status))
-            return SubscriptionStateErr::ConnectionExpired{};
+            // the connection decides what goes out first, a queued object of
+            // the same group is stale for LatestPerGroup as well
+            bool mustFlush = connectionState.schedule_object(
+            ScheduledObject{ *previouslySentObject_, std::move(object.payload_),
+                             subscriberPriority_, trackPublisherPriority_, groupOrder_,
+                             timeoutDuration, false, datagram_ },
+            nextOperation_ == NextOperation::LatestPerGroup);
+            if (mustFlush)
+                connectionsToFlush.push_back(
+                { &connectionState, subscriptionState_->connectionStateWeakPtr_ });
+            subscriptionState_->recentSends_++;
+        }
     }
 
     return false;
 }
 
+void MinorSubscriptionState::end_previous_group(ConnectionState& connectionState,
+                                                ConnectionsToFlush& connectionsToFlush)
+{
+    if (!previouslySentObject_.has_value() || previousGroupEnded_)
+        return;
+    previousGroupEnded_ = true;
+
+    if (connectionState.schedule_object(
+        ScheduledObject::end_of_group(*previouslySentObject_, subscriberPriority_,
+                                      trackPublisherPriority_, groupOrder_, datagram_)))
+        connectionsToFlush.push_back({ &connectionState, subscriptionState_->connectionStateWeakPtr_ });
+}
+
 // returns true if fulfilling is done
-FulfillSomeReturn SubscriptionState::fulfill_some()
+FulfillSomeReturn SubscriptionState::fulfill_some(FanoutCache& fanoutCache, ConnectionsToFlush& connectionsToFlush)
 {
+    if (!trackHandle_) [[unlikely]]
+    {
+        if (!trackWaitSignal_->is_ready(std::memory_order_relaxed))
+        {
+            // expired() does not lock the connection, cheap enough to poll
+            if (connection_expired())
+                return SubscriptionStateErr::ConnectionExpired{};
+            return false;
+        }
+
+        trackWaitSignal_->is_ready(std::memory_order_acquire);
+        if (!try_activate())
+            return SubscriptionStateErr::ConnectionExpired{};
+        if (!trackHandle_)
+            return false;
+    }
+
     bool allFulfilled = true;
     auto beginIter = minorSubscriptionStates_.begin();
     auto endIter = minorSubscriptionStates_.end();
@@ -160,7 +271,7 @@ FulfillSomeReturn SubscriptionState::fulfill_some()
         // not waiting on object to be ready or waiting on it and it is ready
         // basically the mathematical logical statement: (waiting -> ready)
         if (traversalIter->is_waiting_for_object())
-            fulfillReturn = traversalIter->fulfill_some_minor();
+            fulfillReturn = traversalIter->fulfill_some_minor(fanoutCache, connectionsToFlush);
 
         if (std::holds_alternative<bool>(fulfillReturn))
         {
@@ -181,69 +292,142 @@ FulfillSomeReturn SubscriptionState::fulfill_some()
     return allFulfilled;
 }
 
+bool SubscriptionState::is_idle() const noexcept
+{
+    if (!trackHandle_) [[unlikely]]
+        return !trackWaitSignal_->is_ready(std::memory_order_relaxed);
+
+    return std::none_of(minorSubscriptionStates_.begin(), minorSubscriptionStates_.end(),
+                        [](const MinorSubscriptionState& minorSubscriptionState)
+                        { return minorSubscriptionState.is_waiting_for_object(); });
+}
+
+std::optional<WaitSignal> SubscriptionState::wake_signal() const noexcept
+{
+    // pending subscriptions poll their connection
+    if (!trackHandle_) [[unlikely]]
+        return std::nullopt;
+
+    // every filter sets up a single minor subscription
+    if (minorSubscriptionStates_.size() != 1)
+        return std::nullopt;
+    return minorSubscriptionStates_.front().waitSignal_;
+}
+
 SubscriptionState::SubscriptionState(std::weak_ptr<ConnectionState>&& connectionState,
                                      DataManager& dataManager,
                                      SubscriptionManager& subscriptionManager,
                                      SubscribeMessage subscriptionMessage)
 : connectionStateWeakPtr_(std::move(connectionState)),
+  connectionState_(connectionStateWeakPtr_.lock().get()),
   dataManager_(std::addressof(dataManager)),
   subscriptionManager_(std::addressof(subscriptionManager)),
   subscriptionMessage_(std::move(subscriptionMessage)), cleanup_(false)
+{
+    if (!try_activate())
+        subscriptionManager_->mark_subscription_cleanup(*this);
+}
+
+bool SubscriptionState::try_activate()
 {
     auto filterType = subscriptionMessage_.filterType_;
     auto connectionStateSharedPtr = connectionStateWeakPtr_.lock();
 
     if (!connectionStateSharedPtr)
-    {
-        subscriptionManager_->mark_subscription_cleanup(*this);
-        return;
-    }
+        return false;
 
     auto trackIdentifier =
     *connectionStateSharedPtr->alias_to_identifier(subscriptionMessage_.trackAlias_);
 
+    auto trackHandleOrStatus = dataManager_->get_track_handle(trackIdentifier);
+    if (std::holds_alternative<WaitSignal>(trackHandleOrStatus))
+    {
+        // subscribed ahead of the publisher, the signal is set once
+        // add_track_identifier adds the track
+        trackWaitSignal_ = std::move(std::get<WaitSignal>(trackHandleOrStatus));
+        return true;
+    }
+
+    trackWaitSignal_.reset();
+    trackHandle_ = std::get<std::shared_ptr<TrackHandle>>(std::move(trackHandleOrStatus));
+
     auto deliveryTimeoutParamOpt =
     subscriptionMessage_.get_parameter<DeliveryTimeoutParameter>();
     std::optional<std::chrono::milliseconds> deliveryTimeoutOpt;
     if (deliveryTimeoutParamOpt.has_value())
         deliveryTimeoutOpt = deliveryTimeoutParamOpt->timeout_;
 
-    auto trackHandleOrStatus = dataManager_->get_track_handle(trackIdentifier);
-    if (std::holds_alternative<WaitSignal>(trackHandleOrStatus))
+    PublisherPriority trackPublisherPriority =
+    dataManager_->get_track_publisher_priority(trackIdentifier);
+
+    if (subscriptionMessage_.groupOrder_ > utils::to_underlying(GroupOrder::Descending))
     {
-        // TODO: Handle wait condition
-        utils::ASSERT_LOG_THROW(false, "Track is not ready", trackIdentifier);
+        LOGE("Invalid group order", trackIdentifier, subscriptionMessage_.groupOrder_);
+        subscriptionManager_->notify_subscription_error(*this);
+        return false;
     }
 
-    trackHandle_ = std::get<std::shared_ptr<TrackHandle>>(std::move(trackHandleOrStatus));
+    auto make_object_identifier = [&trackIdentifier](const GroupObjectPair& groupObjectPair)
+    { return ObjectIdentifier(trackIdentifier, groupObjectPair.group_, groupObjectPair.object_); };
 
     switch (filterType)
     {
         case SubscribeFilterType::LatestObject:
         {
-            // TODO: check status of current group stuff in latest draft
-            std::optional<GroupId> currGroupOpt =
-            connectionStateSharedPtr->get_current_group(trackIdentifier);
-
-            if (!currGroupOpt)
-                currGroupOpt = GroupId(0);
-
-            PublisherPriority trackPublisherPriority =
-            dataManager_->get_track_publisher_priority(trackIdentifier);
-
-            minorSubscriptionStates_.emplace_back(*this, NextOperation::Latest,
+            minorSubscriptionStates_.emplace_back(*this, NextOperation::Latest, std::nullopt,
                                                   std::nullopt, trackPublisherPriority,
                                                   deliveryTimeoutOpt);
-
             break;
         }
-        case SubscribeFilterType::AbsoluteStart:
+        case SubscribeFilterType::LatestPerGroupInTrack:
         {
-            // TODO
+            minorSubscriptionStates_.emplace_back(*this, NextOperation::LatestPerGroup,
+                                                  std::nullopt, std::nullopt,
+                                                  trackPublisherPriority, deliveryTimeoutOpt);
+            break;
         }
+        case SubscribeFilterType::LatestGroup:
+        {
+            // from the beginning of the current group, or of the first group
+            // if nothing was published yet
+            std::optional<GroupId> latestGroupId = trackHandle_->latest_group_id();
+            if (latestGroupId.has_value())
+                minorSubscriptionStates_.emplace_back(*this, NextOperation::Seek,
+                                                      ObjectIdentifier(trackIdentifier,
+                                                                       *latestGroupId, ObjectId(0)),
+                                                      std::nullopt, trackPublisherPriority,
+                                                      deliveryTimeoutOpt);
+            else
+                minorSubscriptionStates_.emplace_back(*this, NextOperation::First,
+                                                      std::nullopt, std::nullopt,
+                                                      trackPublisherPriority, deliveryTimeoutOpt);
+            break;
+        }
+        case SubscribeFilterType::AbsoluteStart:
         case SubscribeFilterType::AbsoluteRange:
         {
-            // TODO
+            bool isRange = filterType == SubscribeFilterType::AbsoluteRange;
+            const auto& start = subscriptionMessage_.start_;
+            const auto& end = subscriptionMessage_.end_;
+            if (!start.has_value() || (isRange && !end.has_value()) ||
+                (isRange && std::make_tuple(end->group_, end->object_) <
+                            std::make_tuple(start->group_, start->object_)))
+            {
+                LOGE("Invalid subscribe range", trackIdentifier);
+                subscriptionManager_->notify_subscription_error(*this);
+                return false;
+            }
+
+            std::optional<ObjectIdentifier> lastObjectToBeSent;
+            if (isRange)
+                lastObjectToBeSent = make_object_identifier(*end);
+
+            // positioned with a lookup, history is streamed from there on
+            minorSubscriptionStates_.emplace_back(*this, NextOperation::Seek,
+                                                  make_object_identifier(*start),
+                                                  std::move(lastObjectToBeSent),
+                                                  trackPublisherPriority, deliveryTimeoutOpt);
+            break;
         }
         default:
         {
@@ -251,78 +435,249 @@ SubscriptionState::SubscriptionState(std::weak_ptr<ConnectionState>&& connection
                                     utils::to_underlying(filterType));
         }
     }
+
+    return true;
+}
+
+void ThreadLocalState::rebuild_wake_signals()
+{
+    auto& subscriptionStates = runQueue_.tasks_;
+    wakeSignals_.notifiers_.resize(subscriptionStates.size());
+    wakeSignals_.observedEpochs_.resize(subscriptionStates.size());
+
+    for (std::size_t idx = 0; idx < subscriptionStates.size(); idx++)
+        wakeSignals_.set(idx, subscriptionStates[idx]->wake_signal());
+    wakeSignalsStale_ = false;
+}
+
+bool ThreadLocalState::is_idle() const noexcept
+{
+    // handles may have been erased or donated
+    if (wakeSignalsStale_)
+        return false;
+
+    auto isIdle = [this](std::size_t idx)
+    {
+        // subscriptions without a single signal know better
+        if (wakeSignals_.notifiers_[idx] == nullptr)
+            return runQueue_.tasks_[idx]->is_idle();
+        return !wakeSignals_.is_ready(idx);
+    };
+
+    std::size_t numSubscriptions = runQueue_.tasks_.size();
+    for (std::size_t idx = 0; idx < numSubscriptions; idx++)
+        if (!isIdle(idx))
+            return false;
+
+    return subscriptionManager_.subscriptionQueue_.size_approx() == 0 &&
+           !runQueue_.has_inbox() &&
+           std::none_of(connectionsToFlush_.begin(), connectionsToFlush_.end(),
+                        [](const ConnectionToFlush& connectionToFlush)
+                        {
+                            return !connectionToFlush.connectionStateWeakPtr_.expired() &&
+                                   connectionToFlush.connectionState_->can_flush();
+                        });
+}
+
+void ThreadLocalState::update_load() noexcept
+{
+    std::uint64_t load = 0;
+    for (SubscriptionState* subscriptionState : runQueue_.tasks_)
+        load += subscriptionState->take_load();
+    runQueue_.set_load(load);
+}
+
+void ThreadLocalState::request_steal() noexcept
+{
+    ThreadLocalState* victim = nullptr;
+    std::uint64_t victimLoad = runQueue_.load() + minStealLoad;
+    for (auto& threadLocalState : subscriptionManager_.threadLocalStates_)
+    {
+        std::uint64_t load = threadLocalState.runQueue_.load();
+        if (&threadLocalState != this && load > victimLoad)
+        {
+            victim = &threadLocalState;
+            victimLoad = load;
+        }
+    }
+
+    if (victim != nullptr)
+        stealRequested_ = victim->runQueue_.request_steal(threadIdx_);
+}
+
+void ThreadLocalState::answer_steal_request()
+{
+    std::size_t thiefIdx = runQueue_.take_steal_request();
+    if (thiefIdx == RunQueue<SubscriptionState>::noThief) [[likely]]
+        return;
+
+    ThreadLocalState& thief = subscriptionManager_.threadLocalStates_[thiefIdx];
+    // the thief clears its request once it is no longer idle, answered or not
+    if (runQueue_.donate_to(thief.runQueue_, [](const SubscriptionState& subscriptionState)
+                            { return subscriptionState.load(); }) != 0)
+    {
+        wakeSignalsStale_ = true;
+        // the thief may have parked in the meantime
+        subscriptionManager_.dataManager_.activityNotifier_.notify();
+    }
 }
 
 void ThreadLocalState::operator()()
 {
+    auto& subscriptionStates_ = runQueue_.tasks_;
+    std::uint64_t numRounds = 0;
+    std::uint64_t numIdleRounds = 0;
     while (true)
     {
-        // relaxed load and store works because there is no data dependencies
-        // with cleanup_ used to denate that destructor of SubscriptionManager
-        // is called, subscription threads should exit now
+        // observed before the round, anything published, added or enqueued
+        // while the round runs sets the signal and we do not park
+        WaitSignal activitySignal(subscriptionManager_.dataManager_.activityNotifier_);
+
+        // relaxed load works because the destructor notifies after setting
+        // cleanup_ and the signal above is an acquire load, the flag is
+        // either seen here or the signal is set and we do not park
         if (subscriptionManager_.cleanup_.load(std::memory_order_relaxed)) [[unlikely]]
             break;
 
-        auto& subscriptionQueue_ = subscriptionManager_.subscriptionQueue_;
-
-        // If we believe it there are pending subscriptions, dequeue them
-        // Why are we doing size_approx? Because constructing weak_ptr is a
-        // rather expensive lock opertion We want to do it only if we believe
-        // there are pending subscriptions
-        if (subscriptionQueue_.size_approx() != 0)
+        bool isIdle;
         {
-            std::tuple<std::weak_ptr<ConnectionState>, SubscribeMessage> subscriptionTuple;
-            while (subscriptionQueue_.try_dequeue(subscriptionTuple))
+            // the round dereferences connections without locking them, a
+            // connection which has not expired when the round looks at it is
+            // not destroyed before the guard is dropped (ConnectionState::create)
+            EpochDomain::Guard guard(*EpochDomainHandle());
+
+            auto& subscriptionQueue_ = subscriptionManager_.subscriptionQueue_;
+
+            // If we believe it there are pending subscriptions, dequeue them
+            // Why are we doing size_approx? Because constructing weak_ptr is a
+            // rather expensive lock opertion We want to do it only if we believe
+            // there are pending subscriptions
+            if (subscriptionQueue_.size_approx() != 0)
             {
-                auto connectionStateWeakPtr = std::move(std::get<0>(subscriptionTuple));
-                auto subscriptionMessage = std::move(std::get<1>(subscriptionTuple));
-
-                subscriptionStates_.emplace_back(std::move(connectionStateWeakPtr),
-                                                 subscriptionManager_.dataManager_,
-                                                 subscriptionManager_,
-                                                 std::move(subscriptionMessage));
-                if (subscriptionStates_.back().cleanup_)
-                    subscriptionStates_.pop_back();
+                std::tuple<std::weak_ptr<ConnectionState>, SubscribeMessage> subscriptionTuple;
+                while (subscriptionQueue_.try_dequeue(subscriptionTuple))
+                {
+                    auto connectionStateWeakPtr = std::move(std::get<0>(subscriptionTuple));
+                    auto subscriptionMessage = std::move(std::get<1>(subscriptionTuple));
+
+                    SubscriptionState* subscriptionState =
+                    subscriptionManager_.subscriptionStates_.emplace(std::move(connectionStateWeakPtr),
+                                                                     subscriptionManager_.dataManager_,
+                                                                     subscriptionManager_,
+                                                                     std::move(subscriptionMessage));
+                    if (subscriptionState->cleanup_)
+                        subscriptionManager_.subscriptionStates_.erase(subscriptionState);
+                    else
+                    {
+                        subscriptionStates_.push_back(subscriptionState);
+                        wakeSignalsStale_ = true;
+                    }
+                }
             }
-        }
 
-        auto beginIter = subscriptionStates_.begin();
-        auto endIter = subscriptionStates_.end();
+            // subscriptions donated by other threads
+            if (runQueue_.has_inbox())
+            {
+                runQueue_.collect_inbox();
+                wakeSignalsStale_ = true;
+            }
 
-        for (auto traversalIter = beginIter; traversalIter != endIter; ++traversalIter)
-        {
-            auto fulfillReturn = traversalIter->fulfill_some();
+            if (wakeSignalsStale_)
+                rebuild_wake_signals();
 
-            if (std::holds_alternative<bool>(fulfillReturn))
-            // subscription is being fulfilled with no issues
+            std::size_t numSubscriptions = subscriptionStates_.size();
+            bool hasErased = false;
+            for (std::size_t idx = 0; idx < numSubscriptions; idx++)
             {
-                if (std::get<bool>(fulfillReturn) == false)
-                    // This unfortunately does not seem to be using move
-                    // constructor though (according to perf report)
-                    // TODO: debug the issue
-                    *beginIter++ = std::move(*traversalIter);
+                // most subscriptions wait on a signal which is not set, they are
+                // skipped without touching their state
+                if (!wakeSignals_.is_ready(idx))
+                    continue;
+
+                SubscriptionState* subscriptionState = subscriptionStates_[idx];
+                auto fulfillReturn =
+                subscriptionState->fulfill_some(fanoutCache_, connectionsToFlush_);
+
+                // subscription is being fulfilled with no issues
+                if (std::holds_alternative<bool>(fulfillReturn) && std::get<bool>(fulfillReturn) == false)
+                {
+                    wakeSignals_.set(idx, subscriptionState->wake_signal());
+                    continue;
+                }
+
+                // fulfilled or the connection expired, the slot is reused,
+                // the pointer is dropped from the run queue after the scan
+                subscriptionManager_.subscriptionStates_.erase(subscriptionState);
+                subscriptionStates_[idx] = nullptr;
+                hasErased = true;
             }
-            else if (std::holds_alternative<SubscriptionStateErr::ConnectionExpired>(fulfillReturn))
+            if (hasErased)
             {
-                // Nothing to be done
+                std::erase(subscriptionStates_, nullptr);
+                wakeSignalsStale_ = true;
             }
-            else
-                assert(false);
+            fanoutCache_.clear();
+
+            // objects of the round go out in priority order, connections which
+            // are out of send budget are flushed again once they have some
+            std::erase_if(connectionsToFlush_,
+                          [](const ConnectionToFlush& connectionToFlush)
+                          {
+                              if (connectionToFlush.connectionStateWeakPtr_.expired())
+                                  return true;
+                              ConnectionState& connectionState = *connectionToFlush.connectionState_;
+                              if (!connectionState.can_flush())
+                                  return false;
+                              return !connectionState.flush_scheduled_objects();
+                          });
+
+            if (++numRounds % loadWindowRounds == 0)
+                update_load();
+            answer_steal_request();
+            isIdle = is_idle();
+        }
+
+        if (!isIdle)
+        {
+            // spinning paid off, spin longer next time
+            if (numIdleRounds != 0)
+                spinRounds_ = std::min(spinRounds_ * 2, maxSpinRounds);
+            numIdleRounds = 0;
+            stealRequested_ = false;
+            continue;
         }
 
-        subscriptionStates_.erase(beginIter, endIter);
+        if (numIdleRounds == 0 && !stealRequested_)
+        {
+            // idle threads do not see new rounds, the load is stale
+            update_load();
+            request_steal();
+        }
+
+        if (++numIdleRounds < spinRounds_)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // nothing showed up while spinning, block until a track is published
+        // to, a track is added or a subscription is enqueued
+        spinRounds_ = std::max(spinRounds_ / 2, minSpinRounds);
+        numIdleRounds = 0;
+        stealRequested_ = false;
+        activitySignal.wait();
     }
 }
 
 SubscriptionManager::SubscriptionManager(DataManager& dataManager, std::size_t numThreads)
 : dataManager_(dataManager), cleanup_(false)
 {
-    threadLocalStates_.reserve(numThreads);
+    // every state exists before any thread runs, threads look at each other
+    // to steal work
     for (std::size_t i = 0; i < numThreads; i++)
-    {
-        threadLocalStates_.emplace_back(*this);
-        threadPool_.emplace_back(threadLocalStates_.back());
-    }
+        threadLocalStates_.emplace_back(*this, i);
+    for (auto& threadLocalState : threadLocalStates_)
+        threadPool_.emplace_back(std::ref(threadLocalState));
 }
 
 SubscriptionManager::~SubscriptionManager()
@@ -332,6 +687,8 @@ SubscriptionManager::~SubscriptionManager()
     // cleanup_ it is just a single flag to be set, this might change if we are
     // doing more complex things before setting cleanup
     cleanup_.store(true, std::memory_order_relaxed);
+    // wake parked threads so that they observe cleanup_
+    dataManager_.activityNotifier_.notify();
 }
 
 void SubscriptionManager::add_subscription(std::weak_ptr<ConnectionState> connectionStateWeakPtr,
@@ -339,6 +696,7 @@ void SubscriptionManager::add_subscription(std::weak_ptr<ConnectionState> connec
 {
     subscriptionQueue_.enqueue(std::make_tuple(std::move(connectionStateWeakPtr),
                                                std::move(subscribeMessage)));
+    dataManager_.activityNotifier_.notify();
 }
 
 void SubscriptionManager::mark_subscription_cleanup(SubscriptionState& subscriptionState)
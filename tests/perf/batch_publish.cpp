@@ -0,0 +1,125 @@
+/////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <variant>
+#include <vector>
+/////////////////////////////////////////////////////////
+#include <data_manager.hpp>
+/////////////////////////////////////////////////////////
+
+using namespace rvn;
+
+/*
+    Compares publishing objects one at a time (add_object) against batches
+    (add_objects). Subscribers follow the track on their own threads and
+    block on the WaitSignal whenever they caught up, exactly like parked
+    subscriptions, so every wake up of the track is paid for.
+
+    usage: batch_publish [numSubscribers = 4] [objectSize = 1024]
+*/
+
+using SteadyClock = std::chrono::steady_clock;
+
+constexpr std::uint64_t numGroups = 200;
+constexpr std::uint64_t numObjectsPerGroup = 64;
+constexpr std::uint64_t numObjects = numGroups * numObjectsPerGroup;
+
+static void follow_track(TrackHandle& trackHandle)
+{
+    std::optional<ObjectIdentifier> previouslyReceived;
+    for (std::uint64_t numReceived = 0; numReceived < numObjects;)
+    {
+        auto objectOrWait = previouslyReceived.has_value() ?
+                            trackHandle.get_next_object(*previouslyReceived) :
+                            trackHandle.get_first_object();
+
+        if (auto* waitSignal = std::get_if<WaitSignal>(&objectOrWait))
+        {
+            waitSignal->wait();
+            continue;
+        }
+
+        auto& [groupId, objectId, object] = std::get<EnrichedObjectType>(objectOrWait);
+        if (previouslyReceived.has_value())
+        {
+            previouslyReceived->groupId_ = groupId;
+            previouslyReceived->objectId_ = objectId;
+        }
+        else
+            previouslyReceived = ObjectIdentifier(trackHandle.trackIdentifier_, groupId, objectId);
+        numReceived++;
+    }
+}
+
+// returns objects published per second, batchSize == 0 uses add_object
+static double run(std::uint64_t batchSize, std::uint64_t numSubscribers, std::uint64_t objectSize)
+{
+    DataManager dataManager;
+    auto trackHandle =
+    dataManager
+    .add_track_identifier({ "batch_publish" }, std::to_string(batchSize),
+                          PublisherPriority(0), std::nullopt)
+    .lock();
+
+    auto start = SteadyClock::now();
+
+    std::vector<std::thread> subscribers;
+    for (std::uint64_t i = 0; i < numSubscribers; i++)
+        subscribers.emplace_back(follow_track, std::ref(*trackHandle));
+
+    const std::string payload(objectSize, 'x');
+    std::vector<TrackHandle::ObjectBatchEntry> batch;
+    for (std::uint64_t groupId = 0; groupId < numGroups; groupId++)
+        for (std::uint64_t objectId = 0; objectId < numObjectsPerGroup; objectId++)
+        {
+            if (batchSize == 0)
+            {
+                trackHandle->add_object(GroupId(groupId), ObjectId(objectId), payload);
+                continue;
+            }
+
+            batch.emplace_back(GroupId(groupId), ObjectId(objectId), payload);
+            if (batch.size() == batchSize || objectId + 1 == numObjectsPerGroup)
+            {
+                trackHandle->add_objects(batch);
+                batch.clear();
+            }
+        }
+
+    for (auto& subscriber : subscribers)
+        subscriber.join();
+
+    std::chrono::duration<double> elapsed = SteadyClock::now() - start;
+    return numObjects / elapsed.count();
+}
+
+int main(int argc, char** argv)
+{
+    std::uint64_t numSubscribers = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4;
+    std::uint64_t objectSize = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1024;
+
+    std::cout << "objects: " << numObjects << ", subscribers: " << numSubscribers
+              << ", object size: " << objectSize << std::endl;
+
+    // warm up the allocator
+    run(0, numSubscribers, objectSize);
+
+    double singleRate = run(0, numSubscribers, objectSize);
+    std::cout << "add_object Mobjects/s: " << singleRate / 1e6 << std::endl;
+
+    for (std::uint64_t batchSize : { 1, 4, 16, 64 })
+    {
+        double batchRate = run(batchSize, numSubscribers, objectSize);
+        std::cout << "add_objects batch: " << batchSize
+                  << " Mobjects/s: " << batchRate / 1e6
+                  << " (x" << batchRate / singleRate << ")" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,211 @@
+/////////////////////////////////////////////////////////
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <thread>
+#include <vector>
+/////////////////////////////////////////////////////////
+#include <run_queue.hpp>
+#include <segmented_vector.hpp>
+/////////////////////////////////////////////////////////
+
+using namespace rvn;
+
+/*
+    Subscription threads with skewed track popularity. Subscriptions follow
+    tracks whose popularity (objects to send) is zipf distributed and are
+    placed on threads in blocks, so the first thread starts with every hot
+    track, like it happens when one thread dequeues the first burst of
+    subscriptions. Every object sent is a 1 KiB copy.
+
+    Threads either keep their subscriptions (pinned) or steal from loaded
+    threads with the RunQueue protocol used by SubscriptionManager.
+
+    usage: subscription_balancing [numThreads = 4] [numSubscriptions = 1000]
+                                  [numObjects = 1000000]
+*/
+
+using SteadyClock = std::chrono::steady_clock;
+
+constexpr double zipfExponent = 1.2;
+constexpr std::uint64_t objectSize = 1024;
+constexpr std::uint64_t loadWindowRounds = 64;
+constexpr std::uint64_t minStealLoad = 8;
+
+struct Subscription
+{
+    std::uint64_t numObjectsLeft_;
+    std::uint64_t recentSends_ = 0;
+
+    explicit Subscription(std::uint64_t numObjects) : numObjectsLeft_(numObjects)
+    {
+    }
+
+    std::uint64_t load() const noexcept
+    {
+        return 1 + recentSends_;
+    }
+};
+
+struct Worker
+{
+    RunQueue<Subscription> runQueue_;
+    std::uint64_t numSent_ = 0;
+};
+
+static void run_worker(std::deque<Worker>& workers,
+                       SegmentedVector<Subscription>& storage,
+                       std::size_t workerIdx,
+                       bool steal,
+                       std::atomic<std::uint64_t>& numLeft)
+{
+    Worker& worker = workers[workerIdx];
+    auto& subscriptions = worker.runQueue_.tasks_;
+
+    std::vector<std::uint8_t> object(objectSize, 1);
+    std::vector<std::uint8_t> frame(objectSize);
+
+    bool stealRequested = false;
+    for (std::uint64_t numRounds = 1; numLeft.load(std::memory_order_relaxed) != 0; numRounds++)
+    {
+        worker.runQueue_.collect_inbox();
+
+        std::size_t numKept = 0;
+        for (std::size_t idx = 0; idx < subscriptions.size(); idx++)
+        {
+            Subscription* subscription = subscriptions[idx];
+            std::memcpy(frame.data(), object.data(), objectSize);
+            worker.numSent_++;
+            subscription->recentSends_++;
+
+            if (--subscription->numObjectsLeft_ != 0)
+            {
+                subscriptions[numKept++] = subscription;
+                continue;
+            }
+            storage.erase(subscription);
+            numLeft.fetch_sub(1, std::memory_order_relaxed);
+        }
+        subscriptions.resize(numKept);
+
+        if (!steal)
+        {
+            if (subscriptions.empty())
+                std::this_thread::yield();
+            continue;
+        }
+
+        if (numRounds % loadWindowRounds == 0 || subscriptions.empty())
+        {
+            std::uint64_t load = 0;
+            for (Subscription* subscription : subscriptions)
+            {
+                load += subscription->load();
+                subscription->recentSends_ /= 2;
+            }
+            worker.runQueue_.set_load(load);
+        }
+
+        std::size_t thiefIdx = worker.runQueue_.take_steal_request();
+        if (thiefIdx != RunQueue<Subscription>::noThief)
+            worker.runQueue_.donate_to(workers[thiefIdx].runQueue_,
+                                       [](const Subscription& subscription)
+                                       { return subscription.load(); });
+
+        if (!subscriptions.empty() || worker.runQueue_.has_inbox())
+        {
+            stealRequested = false;
+            continue;
+        }
+
+        if (!stealRequested)
+        {
+            Worker* victim = nullptr;
+            std::uint64_t victimLoad = worker.runQueue_.load() + minStealLoad;
+            for (auto& other : workers)
+                if (&other != &worker && other.runQueue_.load() > victimLoad)
+                {
+                    victim = &other;
+                    victimLoad = other.runQueue_.load();
+                }
+            if (victim != nullptr)
+                stealRequested = victim->runQueue_.request_steal(workerIdx);
+        }
+        std::this_thread::yield();
+    }
+}
+
+struct Result
+{
+    double seconds_;
+    // objects sent by the busiest thread over the average
+    double imbalance_;
+};
+
+static Result run(std::uint64_t numThreads, std::uint64_t numSubscriptions, std::uint64_t numObjects, bool steal)
+{
+    double harmonic = 0;
+    for (std::uint64_t i = 0; i < numSubscriptions; i++)
+        harmonic += 1 / std::pow(i + 1, zipfExponent);
+
+    std::deque<Worker> workers(numThreads);
+    SegmentedVector<Subscription> storage;
+    std::uint64_t numSubscriptionsPerThread = (numSubscriptions + numThreads - 1) / numThreads;
+    for (std::uint64_t i = 0; i < numSubscriptions; i++)
+    {
+        auto popularity = static_cast<std::uint64_t>(
+        numObjects / std::pow(i + 1, zipfExponent) / harmonic);
+        workers[i / numSubscriptionsPerThread].runQueue_.tasks_.push_back(
+        storage.emplace(popularity + 1));
+    }
+
+    std::atomic<std::uint64_t> numLeft = numSubscriptions;
+
+    auto start = SteadyClock::now();
+
+    std::vector<std::thread> threads;
+    for (std::size_t workerIdx = 0; workerIdx < numThreads; workerIdx++)
+        threads.emplace_back(run_worker, std::ref(workers), std::ref(storage), workerIdx, steal,
+                             std::ref(numLeft));
+    for (auto& thread : threads)
+        thread.join();
+
+    std::chrono::duration<double> elapsed = SteadyClock::now() - start;
+
+    std::uint64_t maxSent = 0;
+    std::uint64_t totalSent = 0;
+    for (auto& worker : workers)
+    {
+        maxSent = std::max(maxSent, worker.numSent_);
+        totalSent += worker.numSent_;
+    }
+
+    return { elapsed.count(), static_cast<double>(maxSent) * numThreads / totalSent };
+}
+
+int main(int argc, char** argv)
+{
+    std::uint64_t numThreads = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4;
+    std::uint64_t numSubscriptions = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000;
+    std::uint64_t numObjects = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1'000'000;
+
+    std::cout << "threads: " << numThreads << ", subscriptions: " << numSubscriptions
+              << ", objects: " << numObjects
+              << ", hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+
+    Result pinned = run(numThreads, numSubscriptions, numObjects, false);
+    Result stealing = run(numThreads, numSubscriptions, numObjects, true);
+
+    std::cout << "pinned seconds: " << pinned.seconds_ << " imbalance: " << pinned.imbalance_
+              << std::endl;
+    std::cout << "stealing seconds: " << stealing.seconds_
+              << " imbalance: " << stealing.imbalance_
+              << " speedup: " << pinned.seconds_ / stealing.seconds_ << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+/////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <random>
+#include <vector>
+/////////////////////////////////////////////////////////
+#include <segmented_vector.hpp>
+/////////////////////////////////////////////////////////
+
+using namespace rvn;
+
+/*
+    Full passes over the subscription states of a thread (load update,
+    rebuilding the wake signals), std::list against the SegmentedVector
+    with a vector of pointers used by SubscriptionManager.
+
+    Subscriptions churn before the passes, a tenth of them finish and are
+    replaced every churn round while other allocations of the server go on,
+    like it happens over the lifetime of a relay.
+
+    usage: subscription_scan [numSubscriptions = 100000] [numPasses = 100]
+                             [numChurnRounds = 50]
+*/
+
+using SteadyClock = std::chrono::steady_clock;
+
+// about the size of a SubscriptionState
+struct Subscription
+{
+    std::uint64_t recentSends_;
+    std::uint8_t state_[184];
+
+    explicit Subscription(std::uint64_t recentSends) : recentSends_(recentSends)
+    {
+    }
+};
+
+// returns nanoseconds per subscription and pass
+template <typename F> double time_passes(std::uint64_t numSubscriptions, std::uint64_t numPasses, F&& pass)
+{
+    std::uint64_t load = 0;
+    auto start = SteadyClock::now();
+    for (std::uint64_t i = 0; i < numPasses; i++)
+        load += pass();
+    std::chrono::duration<double, std::nano> elapsed = SteadyClock::now() - start;
+
+    // keeps the passes from being optimized out
+    if (load == 0)
+        std::cout << "no load" << std::endl;
+    return elapsed.count() / numPasses / numSubscriptions;
+}
+
+int main(int argc, char** argv)
+{
+    std::uint64_t numSubscriptions = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100'000;
+    std::uint64_t numPasses = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100;
+    std::uint64_t numChurnRounds = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 50;
+
+    std::cout << "subscriptions: " << numSubscriptions << ", passes: " << numPasses
+              << ", churn rounds: " << numChurnRounds << std::endl;
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<std::uint64_t> noiseSize(16, 512);
+    // other allocations of the server, interleaved with the subscriptions
+    std::vector<std::unique_ptr<std::uint8_t[]>> noise;
+
+    std::list<Subscription> list;
+    SegmentedVector<Subscription> storage;
+    std::vector<Subscription*> subscriptions;
+
+    for (std::uint64_t i = 0; i < numSubscriptions; i++)
+    {
+        list.emplace_back(i);
+        subscriptions.push_back(storage.emplace(i));
+        noise.emplace_back(new std::uint8_t[noiseSize(rng)]);
+    }
+
+    for (std::uint64_t round = 0; round < numChurnRounds; round++)
+    {
+        std::uniform_int_distribution<std::uint64_t> pick(0, 9);
+        for (auto iter = list.begin(); iter != list.end();)
+            iter = pick(rng) == 0 ? list.erase(iter) : std::next(iter);
+        std::erase_if(subscriptions,
+                      [&](Subscription* subscription)
+                      {
+                          if (pick(rng) != 0)
+                              return false;
+                          storage.erase(subscription);
+                          return true;
+                      });
+
+        for (auto& block : noise)
+            if (pick(rng) == 0)
+                block.reset(new std::uint8_t[noiseSize(rng)]);
+
+        while (list.size() < numSubscriptions)
+            list.emplace_back(round);
+        while (subscriptions.size() < numSubscriptions)
+            subscriptions.push_back(storage.emplace(round));
+    }
+
+    double listNs = time_passes(numSubscriptions, numPasses,
+                                [&]()
+                                {
+                                    std::uint64_t load = 0;
+                                    for (auto& subscription : list)
+                                    {
+                                        load += 1 + subscription.recentSends_;
+                                        subscription.recentSends_ /= 2;
+                                    }
+                                    return load;
+                                });
+
+    double segmentedNs = time_passes(numSubscriptions, numPasses,
+                                     [&]()
+                                     {
+                                         std::uint64_t load = 0;
+                                         for (Subscription* subscription : subscriptions)
+                                         {
+                                             load += 1 + subscription->recentSends_;
+                                             subscription->recentSends_ /= 2;
+                                         }
+                                         return load;
+                                     });
+
+    std::cout << "list ns per subscription: " << listNs << std::endl;
+    std::cout << "segmented vector ns per subscription: " << segmentedNs
+              << " speedup: " << listNs / segmentedNs << std::endl;
+
+    return 0;
+}
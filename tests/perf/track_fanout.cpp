@@ -0,0 +1,126 @@
+/////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+/////////////////////////////////////////////////////////
+#include <data_manager.hpp>
+#include <subscription_manager.hpp>
+/////////////////////////////////////////////////////////
+
+using namespace rvn;
+
+/*
+    One live track and many caught-up viewers on one subscription thread,
+    the workload FanoutCache is for. Every published object is looked up by
+    each viewer on its own (one TrackHandle lookup per viewer) against
+    through the FanoutCache of the round (one lookup, the other viewers hit
+    the cache and share the payload buffer).
+
+    Only the lookups are measured, scheduling on the connections is the same
+    for both. Viewers of the track on other threads would cost one more
+    lookup per thread.
+
+    usage: track_fanout [numViewers = 10000] [numObjects = 256] [objectSize = 1024]
+*/
+
+using SteadyClock = std::chrono::steady_clock;
+
+struct Viewer
+{
+    std::optional<ObjectIdentifier> position_;
+};
+
+static void advance(Viewer& viewer, TrackHandle& trackHandle, const EnrichedObjectOrWait& objectOrWait)
+{
+    const auto& [groupId, objectId, object] = std::get<EnrichedObjectType>(objectOrWait);
+    if (viewer.position_.has_value())
+    {
+        viewer.position_->groupId_ = groupId;
+        viewer.position_->objectId_ = objectId;
+    }
+    else
+        viewer.position_ = ObjectIdentifier(trackHandle.trackIdentifier_, groupId, objectId);
+}
+
+// returns nanoseconds per viewer and object
+template <typename Lookup>
+static double run(std::uint64_t numViewers, std::uint64_t numObjects, std::uint64_t objectSize, Lookup&& lookup)
+{
+    DataManager dataManager;
+    auto trackHandle =
+    dataManager.add_track_identifier({ "track_fanout" }, "live", PublisherPriority(0), std::nullopt)
+    .lock();
+
+    const std::string payload(objectSize, 'x');
+    // everyone starts on the first object
+    trackHandle->add_object(GroupId(0), ObjectId(0), payload);
+    std::vector<Viewer> viewers(numViewers);
+    for (auto& viewer : viewers)
+        advance(viewer, *trackHandle, trackHandle->get_first_object());
+
+    std::chrono::duration<double, std::nano> elapsed{};
+    for (std::uint64_t objectId = 1; objectId <= numObjects; objectId++)
+    {
+        trackHandle->add_object(GroupId(0), ObjectId(objectId), payload);
+
+        // one round of the subscription thread
+        auto start = SteadyClock::now();
+        lookup(*trackHandle, viewers);
+        elapsed += SteadyClock::now() - start;
+    }
+
+    for (const auto& viewer : viewers)
+        if (viewer.position_->objectId_.get() != numObjects)
+            std::cout << "viewer fell behind" << std::endl;
+
+    return elapsed.count() / numObjects / numViewers;
+}
+
+int main(int argc, char** argv)
+{
+    std::uint64_t numViewers = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000;
+    std::uint64_t numObjects = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 256;
+    std::uint64_t objectSize = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1024;
+
+    std::cout << "viewers: " << numViewers << ", objects: " << numObjects
+              << ", object size: " << objectSize << std::endl;
+
+    auto perViewer = [](TrackHandle& trackHandle, std::vector<Viewer>& viewers)
+    {
+        for (auto& viewer : viewers)
+        {
+            EnrichedObjectOrWait objectOrWait = trackHandle.get_next_object(*viewer.position_);
+            advance(viewer, trackHandle, objectOrWait);
+        }
+    };
+
+    FanoutCache fanoutCache;
+    auto shared = [&fanoutCache](TrackHandle& trackHandle, std::vector<Viewer>& viewers)
+    {
+        for (auto& viewer : viewers)
+        {
+            EnrichedObjectOrWait objectOrWait =
+            fanoutCache.get(trackHandle, NextOperation::Next, viewer.position_,
+                            [&]() { return trackHandle.get_next_object(*viewer.position_); });
+            advance(viewer, trackHandle, objectOrWait);
+        }
+        fanoutCache.clear();
+    };
+
+    // warm up the allocator
+    run(numViewers, numObjects, objectSize, perViewer);
+
+    double perViewerNs = run(numViewers, numObjects, objectSize, perViewer);
+    double sharedNs = run(numViewers, numObjects, objectSize, shared);
+
+    std::cout << "lookup per viewer ns per viewer and object: " << perViewerNs << std::endl;
+    std::cout << "fanout cache ns per viewer and object: " << sharedNs
+              << " speedup: " << perViewerNs / sharedNs << std::endl;
+
+    return 0;
+}
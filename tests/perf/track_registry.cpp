@@ -0,0 +1,111 @@
+/////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+/////////////////////////////////////////////////////////
+#include <data_manager.hpp>
+/////////////////////////////////////////////////////////
+
+using namespace rvn;
+
+/*
+    Stress test of the DataManager track registry, numTracks tracks are
+    created and then looked up, split evenly over 1 to maxThreads threads.
+    Tracks are kept in memory only (no StoragePolicy::dataDirectory_), so
+    nothing is written to disk.
+
+    usage: track_registry [numTracks = 1000000] [maxThreads = 32]
+*/
+
+using SteadyClock = std::chrono::steady_clock;
+
+static std::vector<std::string> track_namespace(std::uint64_t threadId)
+{
+    return { "track_registry", std::to_string(threadId) };
+}
+
+// runs f(threadId) on numThreads threads, returns elapsed seconds
+template <typename F> double run_threads(std::uint64_t numThreads, F&& f)
+{
+    auto start = SteadyClock::now();
+
+    std::vector<std::thread> threads;
+    for (std::uint64_t threadId = 0; threadId < numThreads; threadId++)
+        threads.emplace_back(f, threadId);
+    for (auto& thread : threads)
+        thread.join();
+
+    std::chrono::duration<double> elapsed = SteadyClock::now() - start;
+    return elapsed.count();
+}
+
+int main(int argc, char** argv)
+{
+    std::uint64_t numTracks = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    std::uint64_t maxThreads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 32;
+
+    std::cout << "tracks: " << numTracks << ", hardware threads: "
+              << std::thread::hardware_concurrency() << std::endl;
+
+    // track identifiers are interned once per process, intern them up front so
+    // that every run measures the registry of a fresh DataManager only
+    std::vector<std::vector<TrackIdentifier>> trackIdentifiers(maxThreads);
+    for (std::uint64_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+        for (std::uint64_t threadId = 0; threadId < numThreads; threadId++)
+            for (std::uint64_t trackIdx = trackIdentifiers[threadId].size();
+                 trackIdx < numTracks / numThreads; trackIdx++)
+                trackIdentifiers[threadId].emplace_back(track_namespace(threadId),
+                                                        std::to_string(trackIdx));
+
+    double createRate1 = 0;
+    double lookupRate1 = 0;
+    for (std::uint64_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+    {
+        DataManager dataManager;
+        std::uint64_t numTracksPerThread = numTracks / numThreads;
+
+        double createSeconds = run_threads(
+        numThreads,
+        [&](std::uint64_t threadId)
+        {
+            for (std::uint64_t trackIdx = 0; trackIdx < numTracksPerThread; trackIdx++)
+                dataManager.add_track_identifier(track_namespace(threadId),
+                                                 std::to_string(trackIdx),
+                                                 PublisherPriority(0), std::nullopt);
+        });
+
+        double lookupSeconds = run_threads(
+        numThreads,
+        [&](std::uint64_t threadId)
+        {
+            for (std::uint64_t trackIdx = 0; trackIdx < numTracksPerThread; trackIdx++)
+            {
+                auto trackHandleOrWait =
+                dataManager.get_track_handle(trackIdentifiers[threadId][trackIdx]);
+                utils::ASSERT_LOG_THROW(std::holds_alternative<std::shared_ptr<TrackHandle>>(trackHandleOrWait),
+                                        "Track not found", trackIdentifiers[threadId][trackIdx]);
+            }
+        });
+
+        double createRate = numTracksPerThread * numThreads / createSeconds;
+        double lookupRate = numTracksPerThread * numThreads / lookupSeconds;
+        if (numThreads == 1)
+        {
+            createRate1 = createRate;
+            lookupRate1 = lookupRate;
+        }
+
+        std::cout << "threads: " << numThreads
+                  << " create Mtracks/s: " << createRate / 1e6
+                  << " (x" << createRate / createRate1 << ")"
+                  << " lookup Mtracks/s: " << lookupRate / 1e6
+                  << " (x" << lookupRate / lookupRate1 << ")" << std::endl;
+    }
+
+    return 0;
+}
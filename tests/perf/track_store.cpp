@@ -0,0 +1,156 @@
+/////////////////////////////////////////////////////////
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <vector>
+/////////////////////////////////////////////////////////
+#include <strong_types.hpp>
+#include <track_store.hpp>
+/////////////////////////////////////////////////////////
+
+using namespace rvn;
+
+/*
+    Compares the per group indexed TrackStore against the std::map which was
+    used by TrackHandle before. A single publisher appends objects to one hot
+    track while subscribers (spread over a few reader threads) keep polling
+    for the next object, exactly like MinorSubscriptionState does.
+*/
+
+using SteadyClock = std::chrono::steady_clock;
+using Payload = std::uint64_t;
+
+constexpr std::uint64_t numGroups = 100;
+constexpr std::uint64_t numObjectsPerGroup = 100;
+constexpr std::uint64_t numObjects = numGroups * numObjectsPerGroup;
+const std::uint64_t numReaderThreads =
+std::clamp<std::uint64_t>(std::thread::hardware_concurrency() - 1, 1, 8);
+
+class MapStore
+{
+    std::map<std::tuple<GroupId, ObjectId>, Payload> objects_;
+
+public:
+    using Entry = TrackStore<Payload>::Entry;
+
+    bool emplace(GroupId groupId, ObjectId objectId, Payload payload)
+    {
+        return objects_.emplace(std::make_tuple(groupId, objectId), payload).second;
+    }
+
+    std::optional<Entry> first() const
+    {
+        auto iter = objects_.begin();
+        if (iter == objects_.end())
+            return std::nullopt;
+        return Entry{ std::get<0>(iter->first), std::get<1>(iter->first), iter->second };
+    }
+
+    std::optional<Entry> next(GroupId groupId, ObjectId objectId) const
+    {
+        auto iter = objects_.upper_bound(std::make_tuple(groupId, objectId));
+        if (iter == objects_.end())
+            return std::nullopt;
+        return Entry{ std::get<0>(iter->first), std::get<1>(iter->first), iter->second };
+    }
+};
+
+// readers of the map must hold the publisher mutex, TrackStore readers do not
+template <typename Store> constexpr bool lockFreeReads = false;
+template <> constexpr bool lockFreeReads<TrackStore<Payload>> = true;
+
+struct Subscriber
+{
+    std::optional<std::tuple<GroupId, ObjectId>> previouslySent_;
+    std::uint64_t numReceived_{};
+};
+
+// returns nanoseconds spent per delivered object
+template <typename Store> double run(std::uint64_t numSubscribers)
+{
+    Store store;
+    std::mutex mtx;
+
+    std::vector<Subscriber> subscribers(numSubscribers);
+
+    auto start = SteadyClock::now();
+
+    std::vector<std::thread> readers;
+    for (std::uint64_t threadId = 0; threadId < numReaderThreads; threadId++)
+    {
+        readers.emplace_back(
+        [&, threadId]()
+        {
+            std::uint64_t numDone = 0;
+            std::uint64_t numOwned = 0;
+            for (std::uint64_t i = threadId; i < numSubscribers; i += numReaderThreads)
+                numOwned++;
+
+            while (numDone != numOwned)
+            {
+                for (std::uint64_t i = threadId; i < numSubscribers; i += numReaderThreads)
+                {
+                    Subscriber& subscriber = subscribers[i];
+                    if (subscriber.numReceived_ == numObjects)
+                        continue;
+
+                    std::unique_lock l(mtx, std::defer_lock);
+                    if constexpr (!lockFreeReads<Store>)
+                        l.lock();
+                    auto entry = subscriber.previouslySent_.has_value() ?
+                                 store.next(std::get<0>(*subscriber.previouslySent_),
+                                            std::get<1>(*subscriber.previouslySent_)) :
+                                 store.first();
+                    if constexpr (!lockFreeReads<Store>)
+                        l.unlock();
+
+                    if (!entry.has_value())
+                        continue;
+
+                    subscriber.previouslySent_ =
+                    std::make_tuple(entry->groupId_, entry->objectId_);
+                    if (++subscriber.numReceived_ == numObjects)
+                        numDone++;
+                }
+            }
+        });
+    }
+
+    for (std::uint64_t groupId = 0; groupId < numGroups; groupId++)
+        for (std::uint64_t objectId = 0; objectId < numObjectsPerGroup; objectId++)
+        {
+            std::unique_lock l(mtx);
+            store.emplace(GroupId(groupId), ObjectId(objectId), objectId);
+        }
+
+    for (auto& reader : readers)
+        reader.join();
+
+    std::chrono::duration<double, std::nano> elapsed = SteadyClock::now() - start;
+    return elapsed.count() / (numSubscribers * numObjects);
+}
+
+int main()
+{
+    std::cout << "objects: " << numObjects << ", reader threads: " << numReaderThreads
+              << std::endl;
+
+    for (std::uint64_t numSubscribers : { 1, 10, 100, 1000 })
+    {
+        double mapNs = run<MapStore>(numSubscribers);
+        double storeNs = run<TrackStore<Payload>>(numSubscribers);
+
+        std::cout << "subscribers: " << numSubscribers
+                  << " std::map ns/object: " << mapNs
+                  << " TrackStore ns/object: " << storeNs
+                  << " speedup: " << mapNs / storeNs << std::endl;
+    }
+
+    return 0;
+}
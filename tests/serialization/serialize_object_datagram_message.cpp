@@ -0,0 +1,105 @@
+#include "test_serialization_utils.hpp"
+#include <cassert>
+#include <iostream>
+#include <serialization/chunk.hpp>
+#include <serialization/deserialization_impl.hpp>
+#include <serialization/messages.hpp>
+#include <serialization/serialization_impl.hpp>
+#include <utilities.hpp>
+
+using namespace rvn;
+using namespace rvn::serialization;
+
+ObjectDatagramMessage sample_message()
+{
+    return ObjectDatagramMessage{ { TrackAlias(0x25), GroupId(0x1234), ObjectId(7),
+                                    PublisherPriority(0x80) },
+                                  "datagram" };
+}
+
+void test_serialize_object_datagram()
+{
+    ObjectDatagramMessage msg = sample_message();
+    ds::chunk c;
+    serialization::detail::serialize(c, msg);
+
+    // clang-format off
+    /*
+        00000001      00100101          01010010 00110100      00000111        10000000          00001000
+        [type 0x1] [trackAlias 0x25] [groupId 0x1234]   [objectId 7] [priority 0x80] [payload length 8]
+
+        01100100 01100001 01110100 01100001 01100111 01110010 01100001 01101101
+        [ payload_ = "datagram" ]
+    */
+    std::string expectedSerializationString = "00000001 00100101 01010010 00110100 00000111 10000000 00001000 01100100 01100001 01110100 01100001 01100111 01110010 01100001 01101101";
+    // clang-format on
+    auto expectedSerialization = binary_string_to_vector(expectedSerializationString);
+
+    utils::ASSERT_LOG_THROW(c.size() == expectedSerialization.size(), "Size mismatch\n",
+                            "Expected size: ", expectedSerialization.size(),
+                            "\n", "Actual size: ", c.size(), "\n");
+    for (std::size_t i = 0; i < c.size(); i++)
+        utils::ASSERT_LOG_THROW(c[i] == expectedSerialization[i], "Mismatch at index: ", i,
+                                "\n", "Expected: ", int(expectedSerialization[i]),
+                                "\n", "Actual: ", int(c[i]), "\n");
+
+    ds::ByteSpan span(c.data(), c.size());
+
+    ObjectDatagramMessage deserializedMsg;
+    std::uint64_t numBytes = serialization::detail::deserialize(deserializedMsg, span);
+
+    utils::ASSERT_LOG_THROW(numBytes == c.size(), "Deserialized ", numBytes, " of ",
+                            c.size(), " bytes\n");
+    utils::ASSERT_LOG_THROW(span.size() == 0, "Bytes left in span: ", span.size(), "\n");
+    utils::ASSERT_LOG_THROW(msg == deserializedMsg, "Deserialization failed\n",
+                            "Expected: ", msg, "\n", "Actual: ", deserializedMsg, "\n");
+}
+
+// only OBJECT_DATAGRAM is read from a datagram
+void test_deserialize_wrong_type()
+{
+    ds::chunk c;
+    serialization::detail::serialize(c, sample_message());
+    std::vector<std::uint8_t> bytes(c.data(), c.data() + c.size());
+    bytes[0] = utils::to_underlying(DataStreamType::STREAM_HEADER_SUBGROUP);
+
+    ds::ByteSpan span(bytes.data(), bytes.size());
+    ObjectDatagramMessage deserializedMsg;
+    utils::ASSERT_LOG_THROW(serialization::detail::deserialize(deserializedMsg, span) == 0,
+                            "Deserialized a datagram which is not an OBJECT_DATAGRAM\n");
+}
+
+// a datagram cut short anywhere is dropped, not asserted on
+void test_deserialize_truncated()
+{
+    ds::chunk c;
+    serialization::detail::serialize(c, sample_message());
+
+    for (std::uint64_t length = 0; length < c.size(); length++)
+    {
+        ds::ByteSpan span(c.data(), length);
+        ObjectDatagramMessage deserializedMsg;
+        utils::ASSERT_LOG_THROW(serialization::detail::deserialize(deserializedMsg, span) == 0,
+                                "Deserialized a datagram truncated to ", length, " bytes\n");
+    }
+}
+
+void tests()
+{
+    try
+    {
+        test_serialize_object_datagram();
+        test_deserialize_wrong_type();
+        test_deserialize_truncated();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "test failed\n";
+        std::cerr << e.what() << '\n';
+    }
+}
+int main()
+{
+    tests();
+    return 0;
+}
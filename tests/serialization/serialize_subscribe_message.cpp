@@ -70,11 +70,42 @@ void test1()
                             "Expected: ", msg, "\n", "Actual: ", deserializedMsg, "\n");
 }
 
+void test2()
+{
+    // an object delivery unknown to us is ignored, not fatal
+    SubscribeMessage msg;
+    msg.subscribeId_ = 0x1;
+    msg.trackAlias_ = TrackAlias(0x2);
+    msg.trackNamespace_ = { "namespace" };
+    msg.trackName_ = "trackName";
+    msg.subscriberPriority_ = 0x3;
+    msg.groupOrder_ = 0x4;
+    msg.filterType_ = SubscribeFilterType::LatestGroup;
+    msg.parameters_ = { Parameter{ ObjectDeliveryParameter{ ObjectDelivery::Datagram } } };
+
+    ds::chunk c;
+    serialization::detail::serialize(c, msg);
+    // the delivery is the last byte
+    c[c.size() - 1] = 0x2;
+
+    ds::ChunkSpan span(c);
+    ControlMessageHeader header;
+    serialization::detail::deserialize(header, span);
+
+    SubscribeMessage deserializedMsg;
+    serialization::detail::deserialize(deserializedMsg, span);
+
+    utils::ASSERT_LOG_THROW(deserializedMsg.parameters_.empty(),
+                            "Unknown object delivery was not ignored\n", "Actual: ", deserializedMsg,
+                            "\n");
+}
+
 void tests()
 {
     try
     {
         test1();
+        test2();
     }
     catch (const std::exception& e)
     {
@@ -0,0 +1,122 @@
+#include <array>
+#include <cstring>
+#include <data_manager.hpp>
+#include <limits>
+#include <serialization/chunk.hpp>
+#include <serialization/deserialization_impl.hpp>
+#include <serialization/serialization.hpp>
+#include <string>
+#include <utilities.hpp>
+#include <vector>
+
+using namespace rvn;
+
+using HeaderBytes = std::array<std::uint8_t, ObjectDatagramHeader::maxSerializedLength>;
+
+// first and last value of every quic_var_int length
+static const std::vector<std::uint64_t> varIntBoundaries = { 0,
+                                                             (1ull << 6) - 1,
+                                                             1ull << 6,
+                                                             (1ull << 14) - 1,
+                                                             1ull << 14,
+                                                             (1ull << 30) - 1,
+                                                             1ull << 30,
+                                                             (1ull << 62) - 1 };
+
+// the inline header of DatagramSendContext is byte for byte the chunk one
+void test1()
+{
+    for (std::uint64_t value : varIntBoundaries)
+    {
+        ObjectDatagramHeader header{ TrackAlias(value), GroupId(value), ObjectId(value),
+                                     PublisherPriority(0xff) };
+
+        ds::chunk c;
+        serialization::detail::serialize(c, header);
+
+        HeaderBytes headerBytes{};
+        std::uint64_t headerLength = serialization::detail::serialize(headerBytes, header);
+
+        utils::ASSERT_LOG_THROW(headerLength == c.size(), "Header length mismatch", value,
+                                headerLength, c.size());
+        utils::ASSERT_LOG_THROW(std::memcmp(headerBytes.data(), c.data(), c.size()) == 0,
+                                "Header mismatch", value);
+    }
+}
+
+/*
+    What send_datagrams puts on the wire, the header followed by the stored
+    object past Object::payload_length_offset, is an OBJECT_DATAGRAM which
+    receive_datagram reads back. Its length is what is compared against the
+    largest datagram before falling back to the stream of the group
+*/
+void test2()
+{
+    for (std::uint64_t objectId : varIntBoundaries)
+    {
+        std::string payload = "Object: " + std::to_string(objectId);
+        ObjectDatagramMessage msg{ { TrackAlias(3), GroupId(1ull << 20), ObjectId(objectId),
+                                     PublisherPriority(7) },
+                                   payload };
+
+        SharedQuicBuffer stored = Object::serialize_payload(ObjectId(objectId), payload);
+        std::uint32_t objectOffset = Object::payload_length_offset(stored);
+        utils::ASSERT_LOG_THROW(objectOffset == ds::quic_var_int(objectId).size(),
+                                "Unexpected payload offset", objectId, objectOffset);
+
+        HeaderBytes headerBytes{};
+        std::uint64_t headerLength = serialization::detail::serialize(headerBytes, msg.header_);
+
+        std::vector<std::uint8_t> datagram(headerBytes.begin(), headerBytes.begin() + headerLength);
+        datagram.insert(datagram.end(), stored->Buffer + objectOffset,
+                        stored->Buffer + stored->Length);
+
+        ds::chunk expected;
+        serialization::detail::serialize(expected, msg);
+        utils::ASSERT_LOG_THROW(headerLength + stored->Length - objectOffset == expected.size(),
+                                "Datagram length mismatch", objectId);
+        utils::ASSERT_LOG_THROW(datagram.size() == expected.size() &&
+                                std::memcmp(datagram.data(), expected.data(),
+                                            expected.size()) == 0,
+                                "Datagram mismatch", objectId);
+
+        ds::ByteSpan span(datagram.data(), datagram.size());
+        ObjectDatagramMessage received;
+        utils::ASSERT_LOG_THROW(serialization::detail::deserialize(received, span) ==
+                                datagram.size(),
+                                "Datagram not read whole", objectId);
+        utils::ASSERT_LOG_THROW(received == msg, "Received datagram mismatch", objectId);
+    }
+}
+
+// datagrams carrying trailing bytes or a stream header are not read as objects
+void test3()
+{
+    ObjectDatagramMessage msg{ { TrackAlias(1), GroupId(2), ObjectId(3), PublisherPriority(4) },
+                               "payload" };
+    ds::chunk c;
+    serialization::detail::serialize(c, msg);
+
+    std::vector<std::uint8_t> trailing(c.data(), c.data() + c.size());
+    trailing.push_back(0);
+    ds::ByteSpan trailingSpan(trailing.data(), trailing.size());
+    ObjectDatagramMessage received;
+    serialization::detail::deserialize(received, trailingSpan);
+    utils::ASSERT_LOG_THROW(trailingSpan.size() == 1, "Trailing byte consumed");
+
+    StreamHeaderSubgroupMessage subgroupHeader{ TrackAlias(1), GroupId(2), SubGroupId(0),
+                                                PublisherPriority(4) };
+    ds::chunk subgroup;
+    serialization::detail::serialize(subgroup, subgroupHeader);
+    ds::ByteSpan subgroupSpan(subgroup.data(), subgroup.size());
+    utils::ASSERT_LOG_THROW(serialization::detail::deserialize(received, subgroupSpan) == 0,
+                            "Read a STREAM_HEADER_SUBGROUP as a datagram");
+}
+
+int main()
+{
+    test1();
+    test2();
+    test3();
+    return 0;
+}
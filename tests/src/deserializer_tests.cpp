@@ -17,7 +17,8 @@ UniqueQuicBuffer construct_quic_buffer(std::uint64_t lenBuffer)
     totalQuicBuffer->Buffer =
     reinterpret_cast<uint8_t*>(totalQuicBuffer) + sizeof(QUIC_BUFFER);
 
-    return UniqueQuicBuffer(totalQuicBuffer, QUIC_BUFFERDeleter(nullptr, nullptr));
+    // nothing to hand back to msquic
+    return UniqueQuicBuffer(totalQuicBuffer, QUIC_BUFFERDeleter(nullptr, [](HQUIC, std::uint64_t) {}));
 }
 
 std::vector<UniqueQuicBuffer> generate_quic_buffers(std::vector<ds::chunk> chunks)
@@ -129,9 +130,38 @@ void test2()
     return;
 }
 
+// datagrams carry a header each, they may arrive split or back to back
+void test3()
+{
+    constexpr std::uint64_t NumObjects = 100;
+    std::vector<ds::chunk> chunks(NumObjects);
+    std::vector<ObjectDatagramMessage> sent(NumObjects);
+    for (std::uint64_t i = 0; i < NumObjects; i++)
+    {
+        sent[i].header_ = { TrackAlias(1), GroupId(i / 10), ObjectId(i % 10), PublisherPriority(2) };
+        sent[i].payload_ = "Object Datagram: " + std::to_string(i);
+        serialization::detail::serialize(chunks[i], sent[i]);
+    }
+
+    auto quicBuffers = generate_quic_buffers(chunks);
+
+    std::vector<ObjectDatagramMessage> received;
+    const auto visitor =
+    overloads{ [](auto&&) { std::cout << "Unexpected Message\n"; },
+               [&received](ObjectDatagramMessage o) { received.push_back(std::move(o)); } };
+
+    Deserializer deserializer(false, visitor);
+    for (auto&& quicBuffer : quicBuffers)
+        deserializer.append_buffer(std::move(quicBuffer));
+
+    utils::ASSERT_LOG_THROW(received == sent, "Object datagrams not deserialized",
+                            received.size());
+}
+
 int main()
 {
     test1();
     test2();
+    test3();
     return 0;
 }
@@ -0,0 +1,212 @@
+#include <cstring>
+#include <data_manager.hpp>
+#include <filesystem>
+#include <segment_log.hpp>
+#include <serialization/serialization.hpp>
+#include <string>
+#include <utilities.hpp>
+
+using namespace rvn;
+
+static const std::filesystem::path dataDirectory =
+std::filesystem::temp_directory_path() / "raven_segment_log_tests/";
+
+static std::string payload(std::uint64_t groupId, std::uint64_t objectId)
+{
+    return "Object: " + std::to_string(groupId) + "." + std::to_string(objectId);
+}
+
+static bool payload_matches(const Object& object, std::uint64_t groupId, std::uint64_t objectId)
+{
+    StreamHeaderSubgroupObject subgroupObject;
+    subgroupObject.objectId_ = ObjectId(objectId);
+    subgroupObject.payload_ = payload(groupId, objectId);
+    QUIC_BUFFER* expected = serialization::serialize(subgroupObject);
+
+    bool matches = object.payload_->Length == expected->Length &&
+                   std::memcmp(object.payload_->Buffer, expected->Buffer, expected->Length) == 0;
+
+    free(expected->Buffer);
+    free(expected);
+    return matches;
+}
+
+static DataManager make_data_manager(const std::filesystem::path& directory)
+{
+    RetentionPolicy retentionPolicy;
+    retentionPolicy.maxGroups_ = 1;
+
+    StoragePolicy storagePolicy;
+    storagePolicy.dataDirectory_ = directory.string();
+    // small segments so that the log rolls
+    storagePolicy.segmentLogOptions_.groupsPerSegment_ = 2;
+    return DataManager(retentionPolicy, storagePolicy);
+}
+
+// reads every object of the track, evicted ones are served from the log
+static void check_track(TrackHandle& trackHandle, std::uint64_t numGroups, std::uint64_t numObjects)
+{
+    auto objectOrWait = trackHandle.get_first_object();
+    for (std::uint64_t groupId = 0; groupId < numGroups; groupId++)
+        for (std::uint64_t objectId = 0; objectId < numObjects; objectId++)
+        {
+            utils::ASSERT_LOG_THROW(std::holds_alternative<EnrichedObjectType>(objectOrWait),
+                                    "Missing object", groupId, objectId);
+            auto [gid, oid, object] = std::get<EnrichedObjectType>(std::move(objectOrWait));
+            utils::ASSERT_LOG_THROW(gid == groupId && oid == objectId, "Unexpected object",
+                                    gid, oid);
+            utils::ASSERT_LOG_THROW(payload_matches(object, groupId, objectId),
+                                    "Unexpected payload", groupId, objectId);
+
+            objectOrWait = trackHandle.get_next_object(
+            ObjectIdentifier(trackHandle.trackIdentifier_, GroupId(groupId), ObjectId(objectId)));
+        }
+    utils::ASSERT_LOG_THROW(std::holds_alternative<WaitSignal>(objectOrWait),
+                            "Unexpected trailing object");
+}
+
+// publishes numGroups x numObjects objects to a track persisted in directory
+static void write_track(const std::filesystem::path& directory,
+                        std::uint64_t numGroups,
+                        std::uint64_t numObjects)
+{
+    DataManager dataManager = make_data_manager(directory);
+    auto trackHandle =
+    dataManager.add_track_identifier({ "namespace" }, "track", PublisherPriority(0), std::nullopt)
+    .lock();
+
+    for (std::uint64_t groupId = 0; groupId < numGroups; groupId++)
+        for (std::uint64_t objectId = 0; objectId < numObjects; objectId++)
+            trackHandle->add_object(GroupId(groupId), ObjectId(objectId), payload(groupId, objectId));
+
+    utils::ASSERT_LOG_THROW(trackHandle->objects_.num_groups() == 1, "Retention not enforced");
+    check_track(*trackHandle, numGroups, numObjects);
+}
+
+void test1()
+{
+    // evicted groups are served from the log
+    write_track(dataDirectory / "evicted", 5, 10);
+}
+
+void test2()
+{
+    // a track survives a restart
+    constexpr std::uint64_t numGroups = 5;
+    constexpr std::uint64_t numObjects = 10;
+
+    std::filesystem::path directory = dataDirectory / "restart";
+    write_track(directory, numGroups, numObjects);
+
+    DataManager dataManager = make_data_manager(directory);
+    auto trackHandle =
+    dataManager.add_track_identifier({ "namespace" }, "track", PublisherPriority(0), std::nullopt)
+    .lock();
+
+    check_track(*trackHandle, numGroups, numObjects);
+
+    // history can not be rewritten
+    trackHandle->add_object(GroupId(0), ObjectId(0), "rewritten");
+    trackHandle->add_object(GroupId(numGroups - 1), ObjectId(0), "rewritten");
+    check_track(*trackHandle, numGroups, numObjects);
+}
+
+void test3()
+{
+    // a torn record at the tail of the log is discarded
+    std::filesystem::path trackDirectory = dataDirectory / "torn";
+    {
+        SegmentLog segmentLog(trackDirectory);
+        QUIC_BUFFER quicBuffer{ 4, (std::uint8_t*)"data" };
+        segmentLog.append(GroupId(0), ObjectId(0), SegmentLog::RecordKind::Payload, &quicBuffer);
+        segmentLog.append(GroupId(0), ObjectId(1), SegmentLog::RecordKind::GroupTerminator, nullptr);
+    }
+
+    std::filesystem::path segmentPath = trackDirectory / "0.seg";
+    std::filesystem::resize_file(segmentPath, std::filesystem::file_size(segmentPath) - 1);
+
+    SegmentLog segmentLog(trackDirectory);
+    utils::ASSERT_LOG_THROW(segmentLog.size() == 1, "Torn record was indexed");
+    utils::ASSERT_LOG_THROW(!segmentLog.next(GroupId(0), ObjectId(0)).has_value(),
+                            "Torn record was indexed");
+}
+
+void test4()
+{
+    // a reopened track is positioned by a lookup, in memory and in the log
+    constexpr std::uint64_t numGroups = 5;
+
+    std::filesystem::path directory = dataDirectory / "lookup";
+    write_track(directory, numGroups, 10);
+
+    DataManager dataManager = make_data_manager(directory);
+    auto trackHandle =
+    dataManager.add_track_identifier({ "namespace" }, "track", PublisherPriority(0), std::nullopt)
+    .lock();
+
+    utils::ASSERT_LOG_THROW(trackHandle->latest_group_id() == GroupId(numGroups - 1),
+                            "Unexpected latest group");
+
+    for (std::uint64_t groupId = 0; groupId < numGroups; groupId++)
+    {
+        auto objectOrWait = trackHandle->get_object_at_or_after(GroupId(groupId), ObjectId(3));
+        auto [gid, oid, object] = std::get<EnrichedObjectType>(std::move(objectOrWait));
+        utils::ASSERT_LOG_THROW(gid == groupId && oid == 3, "Unexpected seek", gid, oid);
+        utils::ASSERT_LOG_THROW(payload_matches(object, groupId, 3), "Unexpected payload",
+                                groupId);
+    }
+
+    // past the end of a group continues with the next group
+    auto objectOrWait = trackHandle->get_object_at_or_after(GroupId(1), ObjectId(100));
+    auto [gid, oid, object] = std::get<EnrichedObjectType>(std::move(objectOrWait));
+    utils::ASSERT_LOG_THROW(gid == 2 && oid == 0, "Unexpected seek", gid, oid);
+
+    utils::ASSERT_LOG_THROW(std::holds_alternative<WaitSignal>(trackHandle->get_object_at_or_after(
+                            GroupId(numGroups - 1), ObjectId(100))),
+                            "Seek past the end should wait");
+}
+
+void test5()
+{
+    // segments beyond maxSegments_ are deleted, borrowed payloads stay valid
+    std::filesystem::path trackDirectory = dataDirectory / "max_segments";
+    SegmentLogOptions options;
+    options.groupsPerSegment_ = 1;
+    options.maxSegments_ = 2;
+
+    SegmentLog segmentLog(trackDirectory, options);
+    QUIC_BUFFER quicBuffer{ 4, (std::uint8_t*)"data" };
+    segmentLog.append(GroupId(0), ObjectId(0), SegmentLog::RecordKind::Payload, &quicBuffer);
+    auto borrowed = segmentLog.first();
+
+    for (std::uint64_t groupId = 1; groupId < 5; groupId++)
+        segmentLog.append(GroupId(groupId), ObjectId(0), SegmentLog::RecordKind::Payload, &quicBuffer);
+
+    auto numSegmentFiles =
+    std::distance(std::filesystem::directory_iterator(trackDirectory), {});
+    utils::ASSERT_LOG_THROW(numSegmentFiles == 2, "Segments not deleted", numSegmentFiles);
+    utils::ASSERT_LOG_THROW(segmentLog.size() == 2, "Dropped groups still indexed");
+    utils::ASSERT_LOG_THROW(segmentLog.first()->groupId_ == 3, "Unexpected first group");
+
+    utils::ASSERT_LOG_THROW(std::memcmp(borrowed->payload_->Buffer, "data", 4) == 0,
+                            "Borrowed payload was unmapped");
+    borrowed.reset();
+
+    // released once no longer borrowed
+    segmentLog.append(GroupId(5), ObjectId(0), SegmentLog::RecordKind::Payload, &quicBuffer);
+    utils::ASSERT_LOG_THROW(segmentLog.first()->groupId_ == 4, "Unexpected first group");
+}
+
+int main()
+{
+    std::filesystem::remove_all(dataDirectory);
+
+    test1();
+    test2();
+    test3();
+    test4();
+    test5();
+
+    std::filesystem::remove_all(dataDirectory);
+    return 0;
+}
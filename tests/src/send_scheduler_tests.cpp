@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <data_manager.hpp>
+#include <send_scheduler.hpp>
+#include <tuple>
+#include <utilities.hpp>
+#include <vector>
+
+using namespace rvn;
+
+static const TrackIdentifier audio({ "send_scheduler_tests" }, "audio");
+static const TrackIdentifier video({ "send_scheduler_tests" }, "video");
+static const TrackIdentifier chat({ "send_scheduler_tests" }, "chat");
+
+static std::uint8_t payloadBytes[100];
+static SharedQuicBuffer::Block payloadBlock(QUIC_BUFFER{ sizeof(payloadBytes), payloadBytes },
+                                            SharedQuicBuffer::borrowedRefCount);
+
+static ScheduledObject make_object(const TrackIdentifier& trackIdentifier,
+                                   std::uint64_t groupId,
+                                   std::uint64_t objectId,
+                                   std::uint8_t subscriberPriority,
+                                   std::uint8_t publisherPriority,
+                                   GroupOrder groupOrder = GroupOrder::Ascending)
+{
+    return ScheduledObject{ ObjectIdentifier(trackIdentifier, GroupId(groupId), ObjectId(objectId)),
+                            SharedQuicBuffer::borrow(payloadBlock),
+                            SubscriberPriority(subscriberPriority),
+                            PublisherPriority(publisherPriority),
+                            groupOrder,
+                            std::nullopt };
+}
+
+using Popped = std::tuple<TrackId, std::uint64_t, std::uint64_t>;
+
+static std::vector<Popped> drain(SendScheduler& sendScheduler)
+{
+    std::vector<Popped> popped;
+    while (!sendScheduler.empty())
+    {
+        auto scheduledObject = sendScheduler.pop();
+        popped.emplace_back(scheduledObject.objectIdentifier_.track_id(),
+                            scheduledObject.objectIdentifier_.groupId_.get(),
+                            scheduledObject.objectIdentifier_.objectId_.get());
+    }
+    return popped;
+}
+
+// subscriber priority first, publisher priority second
+void test1()
+{
+    SendScheduler sendScheduler;
+    sendScheduler.push(make_object(chat, 0, 0, 2, 0));
+    sendScheduler.push(make_object(video, 0, 0, 1, 5));
+    sendScheduler.push(make_object(audio, 0, 0, 1, 3));
+
+    std::vector<Popped> expected{ { audio.track_id(), 0, 0 },
+                                  { video.track_id(), 0, 0 },
+                                  { chat.track_id(), 0, 0 } };
+    utils::ASSERT_LOG_THROW(drain(sendScheduler) == expected, "Priorities not respected");
+}
+
+// flows of the same priority take turns
+void test2()
+{
+    SendScheduler sendScheduler;
+    for (std::uint64_t objectId = 0; objectId < 2; objectId++)
+        sendScheduler.push(make_object(audio, 0, objectId, 1, 1));
+    for (std::uint64_t objectId = 0; objectId < 2; objectId++)
+        sendScheduler.push(make_object(video, 0, objectId, 1, 1));
+
+    std::vector<Popped> expected{ { audio.track_id(), 0, 0 },
+                                  { video.track_id(), 0, 0 },
+                                  { audio.track_id(), 0, 1 },
+                                  { video.track_id(), 0, 1 } };
+    utils::ASSERT_LOG_THROW(drain(sendScheduler) == expected, "Flows did not take turns");
+}
+
+// group order of the flow, objects of a group stay in order
+void test3()
+{
+    for (GroupOrder groupOrder : { GroupOrder::Ascending, GroupOrder::Descending })
+    {
+        SendScheduler sendScheduler;
+        for (std::uint64_t groupId = 0; groupId < 2; groupId++)
+            for (std::uint64_t objectId = 0; objectId < 2; objectId++)
+                sendScheduler.push(make_object(video, groupId, objectId, 1, 1, groupOrder));
+
+        std::vector<Popped> expected{ { video.track_id(), 0, 0 },
+                                      { video.track_id(), 0, 1 },
+                                      { video.track_id(), 1, 0 },
+                                      { video.track_id(), 1, 1 } };
+        if (groupOrder == GroupOrder::Descending)
+            std::swap_ranges(expected.begin(), expected.begin() + 2, expected.begin() + 2);
+        utils::ASSERT_LOG_THROW(drain(sendScheduler) == expected, "Group order not respected",
+                                utils::to_underlying(groupOrder));
+    }
+}
+
+// superseding drops the queued objects of the group only
+void test4()
+{
+    SendScheduler sendScheduler;
+    sendScheduler.push(make_object(video, 0, 0, 1, 1), true);
+    sendScheduler.push(make_object(video, 1, 0, 1, 1), true);
+    sendScheduler.push(make_object(video, 0, 1, 1, 1), true);
+    sendScheduler.push(make_object(video, 0, 2, 1, 1), true);
+    utils::ASSERT_LOG_THROW(sendScheduler.size() == 2, "Stale objects not dropped",
+                            sendScheduler.size());
+
+    std::vector<Popped> expected{ { video.track_id(), 0, 2 }, { video.track_id(), 1, 0 } };
+    utils::ASSERT_LOG_THROW(drain(sendScheduler) == expected, "Unexpected objects");
+}
+
+// runs stay within one group of one flow and within their limits
+void test5()
+{
+    SendScheduler sendScheduler;
+    for (std::uint64_t objectId = 0; objectId < 3; objectId++)
+        sendScheduler.push(make_object(video, 0, objectId, 1, 1));
+    sendScheduler.push(make_object(video, 1, 0, 1, 1));
+    sendScheduler.push(make_object(audio, 0, 0, 1, 1));
+
+    std::vector<ScheduledObject> run;
+    sendScheduler.pop_run(run, 2, sizeof(payloadBytes) * 3 / 2);
+    utils::ASSERT_LOG_THROW(run.size() == 1, "Run larger than its byte limit", run.size());
+
+    run.clear();
+    sendScheduler.pop_run(run, 16, 1 << 16);
+    utils::ASSERT_LOG_THROW(run.size() == 1 && run.front().objectIdentifier_.track_id() == audio.track_id(),
+                            "Flows did not take turns between runs");
+
+    run.clear();
+    sendScheduler.pop_run(run, 16, 1 << 16);
+    utils::ASSERT_LOG_THROW(run.size() == 2 && run.back().objectIdentifier_.objectId_ == ObjectId(2),
+                            "Run did not gather the group", run.size());
+
+    std::vector<Popped> expected{ { video.track_id(), 1, 0 } };
+    utils::ASSERT_LOG_THROW(drain(sendScheduler) == expected, "Unexpected objects");
+}
+
+// the end of a group goes out last, in the run of the objects of the group
+void test6()
+{
+    SendScheduler sendScheduler;
+    sendScheduler.push(ScheduledObject::end_of_group(GroupIdentifier(video, GroupId(0)),
+                                                     SubscriberPriority(1), PublisherPriority(1),
+                                                     GroupOrder::Ascending));
+    for (std::uint64_t objectId = 0; objectId < 2; objectId++)
+        sendScheduler.push(make_object(video, 0, objectId, 1, 1));
+    sendScheduler.push(make_object(video, 1, 0, 1, 1));
+    utils::ASSERT_LOG_THROW(sendScheduler.num_bytes() == 3 * sizeof(payloadBytes),
+                            "End of group counted as payload", sendScheduler.num_bytes());
+
+    std::vector<ScheduledObject> run;
+    sendScheduler.pop_run(run, 16, 1 << 16);
+    utils::ASSERT_LOG_THROW(run.size() == 3 && run.back().endOfGroup_ &&
+                            !run.front().endOfGroup_,
+                            "End of group not last in its run", run.size());
+}
+
+// streams and datagrams do not share a run
+void test7()
+{
+    SendScheduler sendScheduler;
+    for (std::uint64_t objectId = 0; objectId < 4; objectId++)
+    {
+        ScheduledObject scheduledObject = make_object(audio, 0, objectId, 1, 1);
+        scheduledObject.datagram_ = objectId >= 2;
+        sendScheduler.push(std::move(scheduledObject));
+    }
+
+    std::vector<ScheduledObject> run;
+    sendScheduler.pop_run(run, 16, 1 << 16);
+    utils::ASSERT_LOG_THROW(run.size() == 2 && !run.back().datagram_,
+                            "Stream run took datagrams", run.size());
+
+    run.clear();
+    sendScheduler.pop_run(run, 16, 1 << 16);
+    utils::ASSERT_LOG_THROW(run.size() == 2 && run.front().datagram_ && run.back().datagram_,
+                            "Datagrams not in a run of their own", run.size());
+}
+
+int main()
+{
+    test1();
+    test2();
+    test3();
+    test4();
+    test5();
+    test6();
+    test7();
+    return 0;
+}
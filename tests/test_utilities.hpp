@@ -50,6 +50,9 @@ client_setup(std::tuple<QUIC_GLOBAL_EXECUTION_CONFIG*, std::uint64_t> executionC
     std::numeric_limits<decltype(Settings.StreamRecvWindowDefault)>::max());
     Settings.IsSet.MaxAckDelayMs = TRUE;
     Settings.MaxAckDelayMs = 0;
+    // subscriptions may ask for objects in datagrams
+    Settings.IsSet.DatagramReceiveEnabled = TRUE;
+    Settings.DatagramReceiveEnabled = TRUE;
     moqtClient->set_Settings(&Settings, sizeof(Settings));
 
     QUIC_CREDENTIAL_CONFIG credConfig;